@@ -0,0 +1,374 @@
+/*
+ * Copyright (c) 2002 - present, H. Hernan Saez
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <Crimild.hpp>
+#include <Crimild_STB.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+using namespace crimild;
+
+namespace crimild {
+
+    namespace examples {
+
+        struct Bitmap {
+            UInt32 width = 0;
+            UInt32 height = 0;
+            std::vector< UInt8 > pixels; // RGBA, top row first
+        };
+
+        /**
+           \brief Loads a sprite sheet with the engine's image loaders
+
+           Any 8-bit RGB or RGBA image supported by the current ImageManager
+           can be used. RGB images are given an opaque alpha channel.
+         */
+        Bool loadSheet( const std::string &path, Bitmap &bitmap )
+        {
+            auto image = ImageManager::getInstance()->loadImage(
+                {
+                    .filePath = {
+                        .path = path,
+                        .pathType = FilePath::PathType::ABSOLUTE,
+                    },
+                } );
+            if ( image == nullptr ) {
+                return false;
+            }
+
+            Size channels = 0;
+            if ( image->format == Format::R8G8B8A8_UNORM ) {
+                channels = 4;
+            } else if ( image->format == Format::R8G8B8_UNORM ) {
+                channels = 3;
+            } else {
+                return false;
+            }
+
+            bitmap.width = UInt32( image->extent.width );
+            bitmap.height = UInt32( image->extent.height );
+
+            const Size count = Size( bitmap.width ) * bitmap.height;
+            if ( image->data.size() < channels * count ) {
+                return false;
+            }
+
+            bitmap.pixels.resize( 4 * count );
+            for ( Size i = 0; i < count; ++i ) {
+                const auto src = &image->data[ channels * i ];
+                const auto dst = &bitmap.pixels[ 4 * i ];
+                dst[ 0 ] = src[ 0 ];
+                dst[ 1 ] = src[ 1 ];
+                dst[ 2 ] = src[ 2 ];
+                dst[ 3 ] = channels == 4 ? src[ 3 ] : 255;
+            }
+
+            return true;
+        }
+
+        /**
+           \brief Parses a sheet given as <path>:<columns>x<rows>
+         */
+        Bool parseSheet( const std::string &spec, std::string &path, UInt32 &columns, UInt32 &rows ) noexcept
+        {
+            const auto colon = spec.rfind( ':' );
+            const auto times = spec.rfind( 'x' );
+            if ( colon == std::string::npos || times == std::string::npos || times < colon ) {
+                return false;
+            }
+
+            auto parse = []( const std::string &str, UInt32 &value ) noexcept {
+                try {
+                    Size end = 0;
+                    const auto n = std::stoul( str, &end );
+                    if ( end != str.size() || n > std::numeric_limits< UInt32 >::max() ) {
+                        return false;
+                    }
+                    value = UInt32( n );
+                    return true;
+                } catch ( const std::exception & ) {
+                    return false;
+                }
+            };
+
+            path = spec.substr( 0, colon );
+            return parse( spec.substr( colon + 1, times - colon - 1 ), columns ) && parse( spec.substr( times + 1 ), rows );
+        }
+
+        Bool saveTGA( const std::string &path, const Bitmap &image ) noexcept
+        {
+            std::ofstream out( path, std::ios::binary );
+            if ( !out ) {
+                return false;
+            }
+
+            UInt8 header[ 18 ] = {};
+            header[ 2 ] = 2;
+            header[ 12 ] = image.width & 0xFF;
+            header[ 13 ] = image.width >> 8;
+            header[ 14 ] = image.height & 0xFF;
+            header[ 15 ] = image.height >> 8;
+            header[ 16 ] = 32;
+            header[ 17 ] = 0x28; // 8 alpha bits, top row first
+            out.write( reinterpret_cast< const char * >( header ), sizeof( header ) );
+
+            std::vector< UInt8 > bgra( image.pixels.size() );
+            for ( Size i = 0; i < bgra.size(); i += 4 ) {
+                bgra[ i + 0 ] = image.pixels[ i + 2 ];
+                bgra[ i + 1 ] = image.pixels[ i + 1 ];
+                bgra[ i + 2 ] = image.pixels[ i + 0 ];
+                bgra[ i + 3 ] = image.pixels[ i + 3 ];
+            }
+            out.write( reinterpret_cast< const char * >( bgra.data() ), bgra.size() );
+
+            return bool( out );
+        }
+
+        /**
+           \brief A single flipbook frame, before and after packing
+         */
+        struct Frame {
+            Size sheet;
+            UInt32 srcX;
+            UInt32 srcY;
+            UInt32 width;
+            UInt32 height;
+            UInt32 dstX = 0;
+            UInt32 dstY = 0;
+        };
+
+        /**
+           \brief Places frames in rows (shelves) of decreasing height
+
+           Frames are expected to be sorted by height. Each one is padded by
+           the gutter on every side so bilinear filtering never samples a
+           neighbor. Returns false if they don't fit in the given size.
+         */
+        Bool packShelves( std::vector< Frame > &frames, UInt32 atlasWidth, UInt32 atlasHeight, UInt32 gutter ) noexcept
+        {
+            UInt32 x = 0;
+            UInt32 y = 0;
+            UInt32 shelfHeight = 0;
+
+            for ( auto &frame : frames ) {
+                const auto w = frame.width + 2 * gutter;
+                const auto h = frame.height + 2 * gutter;
+                if ( w > atlasWidth ) {
+                    return false;
+                }
+                if ( x + w > atlasWidth ) {
+                    x = 0;
+                    y += shelfHeight;
+                    shelfHeight = 0;
+                }
+                if ( y + h > atlasHeight ) {
+                    return false;
+                }
+                frame.dstX = x + gutter;
+                frame.dstY = y + gutter;
+                x += w;
+                shelfHeight = std::max( shelfHeight, h );
+            }
+
+            return true;
+        }
+
+        /**
+           \brief Copies a frame into the atlas, extending its edges into the gutter
+         */
+        void blit( const Bitmap &src, const Frame &frame, Bitmap &atlas, UInt32 gutter ) noexcept
+        {
+            const auto g = Int32( gutter );
+            for ( auto y = -g; y < Int32( frame.height ) + g; ++y ) {
+                const auto sy = frame.srcY + UInt32( std::clamp( y, 0, Int32( frame.height ) - 1 ) );
+                for ( auto x = -g; x < Int32( frame.width ) + g; ++x ) {
+                    const auto sx = frame.srcX + UInt32( std::clamp( x, 0, Int32( frame.width ) - 1 ) );
+                    std::copy_n(
+                        &src.pixels[ 4 * ( Size( sy ) * src.width + sx ) ],
+                        4,
+                        &atlas.pixels[ 4 * ( Size( frame.dstY + y ) * atlas.width + frame.dstX + x ) ] );
+                }
+            }
+        }
+
+    }
+
+}
+
+using namespace crimild::examples;
+
+/**
+   Packs the frames of several flipbook sprite sheets into a single atlas, so
+   all animated particles can be drawn with one texture bound.
+
+   Usage: FlipbookAtlas <output.tga> <sheet>:<columns>x<rows> [...]
+
+   For example, to pack the ParticleShowcase flipbooks:
+
+   FlipbookAtlas atlas.tga flames.tga:4x4 animated_smoke_2.tga:4x4
+
+   Sheets are loaded with the engine's image loaders, so any format they
+   support can be used, and they don't need to be evenly divisible by their
+   grid. The packed atlas
+   is written as an uncompressed TGA and a Lua table with the texture
+   coordinates of every frame (origin at the top-left corner) is printed.
+ */
+int main( int argc, char **argv )
+{
+    if ( argc < 3 ) {
+        std::cout << "Usage: " << argv[ 0 ] << " <output.tga> <sheet>:<columns>x<rows> [...]" << std::endl;
+        return 1;
+    }
+
+    SharedPointer< ImageManager > imageManager = crimild::alloc< crimild::stb::ImageManager >();
+
+    const UInt32 gutter = 1;
+
+    std::vector< std::string > names;
+    std::vector< Bitmap > sheets;
+    std::vector< Frame > frames;
+
+    for ( auto arg = 2; arg < argc; ++arg ) {
+        const std::string spec = argv[ arg ];
+        std::string path;
+        UInt32 columns = 0;
+        UInt32 rows = 0;
+        if ( !parseSheet( spec, path, columns, rows ) ) {
+            std::cout << "Invalid sheet: " << spec << std::endl;
+            return 1;
+        }
+
+        Bitmap sheet;
+        if ( !loadSheet( path, sheet ) ) {
+            std::cout << "Cannot load " << path << std::endl;
+            return 1;
+        }
+
+        if ( columns == 0 || rows == 0 || columns > sheet.width || rows > sheet.height ) {
+            std::cout << "Invalid grid for " << path << std::endl;
+            return 1;
+        }
+
+        // Frames are numbered left to right, top to bottom
+        for ( UInt32 r = 0; r < rows; ++r ) {
+            for ( UInt32 c = 0; c < columns; ++c ) {
+                const auto x0 = c * sheet.width / columns;
+                const auto x1 = ( c + 1 ) * sheet.width / columns;
+                const auto y0 = r * sheet.height / rows;
+                const auto y1 = ( r + 1 ) * sheet.height / rows;
+                frames.push_back( Frame { sheets.size(), x0, y0, x1 - x0, y1 - y0 } );
+            }
+        }
+
+        const auto slash = path.find_last_of( "/\\" );
+        auto name = path.substr( slash == std::string::npos ? 0 : slash + 1 );
+        name = name.substr( 0, name.find( '.' ) );
+        std::replace( name.begin(), name.end(), '-', '_' );
+        names.push_back( name );
+        sheets.push_back( std::move( sheet ) );
+    }
+
+    // Pack in height order, but keep the original order around for the output
+    std::vector< Size > order( frames.size() );
+    for ( Size i = 0; i < order.size(); ++i ) {
+        order[ i ] = i;
+    }
+    std::stable_sort(
+        order.begin(),
+        order.end(),
+        [ & ]( auto a, auto b ) {
+            return frames[ a ].height > frames[ b ].height;
+        } );
+
+    std::vector< Frame > packed( frames.size() );
+    for ( Size i = 0; i < order.size(); ++i ) {
+        packed[ i ] = frames[ order[ i ] ];
+    }
+
+    // Smallest power of two atlas that fits every frame, growing width and
+    // height alternately to keep it as square as possible
+    const UInt32 MAX_ATLAS_SIZE = 16384;
+    Bitmap atlas;
+    atlas.width = 64;
+    atlas.height = 64;
+    while ( !packShelves( packed, atlas.width, atlas.height, gutter ) ) {
+        if ( atlas.width == MAX_ATLAS_SIZE && atlas.height == MAX_ATLAS_SIZE ) {
+            std::cout << "Frames don't fit in a " << MAX_ATLAS_SIZE << "x" << MAX_ATLAS_SIZE << " atlas" << std::endl;
+            return 1;
+        }
+        if ( atlas.height < atlas.width ) {
+            atlas.height *= 2;
+        } else {
+            atlas.width *= 2;
+        }
+    }
+
+    atlas.pixels.assign( 4 * Size( atlas.width ) * atlas.height, 0 );
+    for ( Size i = 0; i < packed.size(); ++i ) {
+        frames[ order[ i ] ] = packed[ i ];
+        blit( sheets[ packed[ i ].sheet ], packed[ i ], atlas, gutter );
+    }
+
+    if ( !saveTGA( argv[ 1 ], atlas ) ) {
+        std::cout << "Cannot write " << argv[ 1 ] << std::endl;
+        return 1;
+    }
+
+    Size usedArea = 0;
+    for ( const auto &frame : frames ) {
+        usedArea += Size( frame.width ) * frame.height;
+    }
+
+    std::cout << "-- " << frames.size() << " frames from " << sheets.size() << " sheets packed into a "
+              << atlas.width << "x" << atlas.height << " atlas ("
+              << ( 100 * usedArea / ( Size( atlas.width ) * atlas.height ) ) << "% used)" << std::endl;
+
+    std::cout << "flipbooks = {" << std::endl;
+    for ( Size s = 0; s < sheets.size(); ++s ) {
+        std::cout << "\t" << names[ s ] << " = {" << std::endl;
+        for ( const auto &frame : frames ) {
+            if ( frame.sheet != s ) {
+                continue;
+            }
+            std::cout << "\t\t{ "
+                      << Real32( frame.dstX ) / atlas.width << ", "
+                      << Real32( frame.dstY ) / atlas.height << ", "
+                      << Real32( frame.dstX + frame.width ) / atlas.width << ", "
+                      << Real32( frame.dstY + frame.height ) / atlas.height << " }," << std::endl;
+        }
+        std::cout << "\t}," << std::endl;
+    }
+    std::cout << "}" << std::endl;
+
+    return 0;
+}
@@ -68,6 +68,12 @@ public:
                     return geometry;
                 };
 
+                // All boxes share the same primitive, so grouping them by material
+                // means geometries using the same pipeline and descriptors are
+                // visited (and drawn) back to back. This takes pipeline/material
+                // switches from one per box down to one per material.
+                auto batches = Array< Array< SharedPointer< Node > > >( materials.size() );
+
                 const auto boxesPerSide = 10.0f;
                 for ( auto x = -boxesPerSide; x <= boxesPerSide; ++x ) {
                     for ( auto y = -boxesPerSide; y <= boxesPerSide; ++y ) {
@@ -82,15 +88,24 @@ public:
                                 Random::generate< Real >( 0.5 * y, 5.0 * y ),
                                 Random::generate< Real >( 0.5 * z, 5.0 * z ),
                             };
-                            scene->attachNode(
+                            auto materialId = Random::generate< Int >( 0, materials.size() );
+                            batches[ materialId ].add(
                                 box(
                                     Point3 { x, y, z } + offset,
                                     size,
-                                    materials[ Random::generate< Int >( 0, materials.size() ) ] ) );
+                                    materials[ materialId ] ) );
                         }
                     }
                 }
 
+                // Each batch is turned into a bounding volume hierarchy (same as the
+                // ray tracing examples do), instead of thousands of siblings under a
+                // flat Group, so camera culling can reject whole branches at once.
+                batches.each(
+                    [ & ]( auto &batch ) {
+                        scene->attachNode( framegraph::utils::optimize( batch ) );
+                    } );
+
                 scene->attachNode( crimild::alloc< Skybox >( ColorRGB { 0.5f, 0.6f, 0.7f } ) );
 
                 scene->attachNode( [] {
@@ -85,85 +85,73 @@ public:
                     return light;
                 }() );
 
-            scene->attachNode(
-                [] {
-                    auto group = crimild::alloc< Group >();
-                    group->attachNode(
-                        [] {
-                            auto geometry = crimild::alloc< Geometry >();
-                            geometry->attachPrimitive(
-                                crimild::alloc< SpherePrimitive >(
-                                    SpherePrimitive::Params {
-                                        .type = Primitive::Type::TRIANGLES,
-                                        .layout = VertexP3N3TC2::getLayout(),
-                                        .radius = 0.1f,
-                                    } ) );
-                            geometry->attachComponent< MaterialComponent >()->attachMaterial(
-                                [] {
-                                    auto material = crimild::alloc< UnlitMaterial >();
-                                    material->setColor( ColorRGBA::Constants::GREEN );
-                                    return material;
-                                }() );
-                            return geometry;
-                        }() );
-                    group->attachNode(
-                        [] {
-                            auto light = crimild::alloc< Light >( Light::Type::POINT );
-                            light->setColor( ColorRGBA { 0.0f, 1.0f, 0.0f, 1.0f } );
-                            light->setEnergy( 10.0f );
-                            return light;
-                        }() );
-                    group->attachComponent< LambdaComponent >(
-                        []( auto node, auto &clock ) {
-                            auto speed = 0.25f;
-                            auto t = speed * clock.getCurrentTime();
-                            auto x = Numericf::remap( -1.0f, 1.0f, -15.0f, 15.0f, Numericf::cos( t ) * Numericf::sin( t ) );
-                            auto y = Numericf::remapSin( -3.0f, 3.0f, t );
-                            auto z = Numericf::remapCos( -15.0f, 15.0f, t );
-                            node->setLocal( translation( x, y, z ) );
-                        } );
-                    return group;
-                }() );
+            // Use the "lights" setting to change the number of moving point lights.
+            // Useful for profiling how shading scales with many light sources.
+            const auto lightCount = Simulation::getInstance()->getSettings()->get< Int32 >( "lights", 2 );
 
-            scene->attachNode(
-                [] {
-                    auto group = crimild::alloc< Group >();
-                    group->attachNode(
-                        [] {
-                            auto geometry = crimild::alloc< Geometry >();
-                            geometry->attachPrimitive(
-                                crimild::alloc< SpherePrimitive >(
-                                    SpherePrimitive::Params {
-                                        .type = Primitive::Type::TRIANGLES,
-                                        .layout = VertexP3N3TC2::getLayout(),
-                                        .radius = 0.1f,
-                                    } ) );
-                            geometry->attachComponent< MaterialComponent >()->attachMaterial(
-                                [] {
-                                    auto material = crimild::alloc< UnlitMaterial >();
-                                    material->setColor( ColorRGBA::Constants::RED );
-                                    return material;
-                                }() );
-                            return geometry;
-                        }() );
-                    group->attachNode(
-                        [] {
-                            auto light = crimild::alloc< Light >( Light::Type::POINT );
-                            light->setColor( ColorRGBA::Constants::RED );
-                            light->setEnergy( 10.0f );
-                            return light;
-                        }() );
-                    group->attachComponent< LambdaComponent >(
-                        []( auto node, auto &clock ) {
-                            auto speed = 0.5f;
-                            auto t = speed * clock.getCurrentTime();
-                            auto x = Numericf::remapSin( -3.0f, 3.0f, t );
-                            auto y = Numericf::remap( -1.0f, 1.0f, -15.0f, 15.0f, Numericf::cos( t ) * Numericf::sin( t ) );
-                            auto z = Numericf::remapCos( -15.0f, 15.0f, t );
-                            node->setLocal( translation( x, y, z ) );
-                        } );
-                    return group;
-                }() );
+            auto lightPrimitive = crimild::alloc< SpherePrimitive >(
+                SpherePrimitive::Params {
+                    .type = Primitive::Type::TRIANGLES,
+                    .layout = VertexP3N3TC2::getLayout(),
+                    .radius = 0.1f,
+                } );
+
+            for ( auto i = 0; i < lightCount; ++i ) {
+                const auto color = [ & ] {
+                    switch ( i ) {
+                        case 0:
+                            return ColorRGBA::Constants::GREEN;
+                        case 1:
+                            return ColorRGBA::Constants::RED;
+                        default:
+                            return ColorRGBA {
+                                Real( rnd.generate( 0.0f, 1.0f ) ),
+                                Real( rnd.generate( 0.0f, 1.0f ) ),
+                                Real( rnd.generate( 0.0f, 1.0f ) ),
+                                1.0f,
+                            };
+                    }
+                }();
+
+                scene->attachNode(
+                    [ & ] {
+                        auto group = crimild::alloc< Group >();
+                        group->attachNode(
+                            [ & ] {
+                                auto geometry = crimild::alloc< Geometry >();
+                                geometry->attachPrimitive( lightPrimitive );
+                                geometry->attachComponent< MaterialComponent >()->attachMaterial(
+                                    [ & ] {
+                                        auto material = crimild::alloc< UnlitMaterial >();
+                                        material->setColor( color );
+                                        return material;
+                                    }() );
+                                return geometry;
+                            }() );
+                        group->attachNode(
+                            [ & ] {
+                                auto light = crimild::alloc< Light >( Light::Type::POINT );
+                                light->setColor( color );
+                                light->setEnergy( 10.0f );
+                                return light;
+                            }() );
+                        group->attachComponent< LambdaComponent >(
+                            [ vertical = ( i % 2 ) == 1,
+                              speed = 0.25f * ( 1 + i % 2 ),
+                              phase = Numericf::TWO_PI * Real( 2 * ( i / 2 ) ) / Real( lightCount ) ]( auto node, auto &clock ) {
+                                auto t = phase + speed * clock.getCurrentTime();
+                                auto a = Numericf::remap( -1.0f, 1.0f, -15.0f, 15.0f, Numericf::cos( t ) * Numericf::sin( t ) );
+                                auto b = Numericf::remapSin( -3.0f, 3.0f, t );
+                                auto z = Numericf::remapCos( -15.0f, 15.0f, t );
+                                if ( vertical ) {
+                                    node->setLocal( translation( b, a, z ) );
+                                } else {
+                                    node->setLocal( translation( a, b, z ) );
+                                }
+                            } );
+                        return group;
+                    }() );
+            }
 
             scene->attachNode(
                 [ & ] {
@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2002 - present, H. Hernan Saez
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <Crimild.hpp>
+
+#include "DepthSort.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace crimild;
+
+using Pair = examples::DepthSort::Pair;
+
+/**
+   \brief Distances from the camera to each particle for two consecutive frames
+
+   In the "coherent" case, particles only move a little between frames, which
+   is what the fire looks like most of the time. In the "shuffled" case,
+   every frame is unrelated to the previous one.
+ */
+struct Frames {
+    std::vector< Real32 > previous;
+    std::vector< Real32 > current;
+};
+
+Frames makeFrames( Size count, Bool coherent, std::mt19937 &rng )
+{
+    std::uniform_real_distribution< Real32 > distance( 1.0f, 50.0f );
+    std::uniform_real_distribution< Real32 > jitter( -0.01f, 0.01f );
+
+    Frames frames;
+    frames.previous.resize( count );
+    frames.current.resize( count );
+    for ( Size i = 0; i < count; ++i ) {
+        frames.previous[ i ] = distance( rng );
+        frames.current[ i ] = coherent ? frames.previous[ i ] + jitter( rng ) : distance( rng );
+    }
+    return frames;
+}
+
+/**
+   \brief Fills pairs the way RadixSortParticleUpdater does
+
+   Particles were sorted by the previous frame, so they are laid out in the
+   order of the previous frame's keys, but with the current frame's distances.
+ */
+void fillPairs( const Frames &frames, std::vector< Pair > &pairs )
+{
+    const auto count = frames.previous.size();
+    std::vector< UInt32 > order( count );
+    for ( Size i = 0; i < count; ++i ) {
+        order[ i ] = UInt32( i );
+    }
+    std::sort(
+        order.begin(),
+        order.end(),
+        [ & ]( UInt32 a, UInt32 b ) {
+            return examples::DepthSort::toKey( frames.previous[ a ] ) < examples::DepthSort::toKey( frames.previous[ b ] );
+        } );
+
+    pairs.resize( count );
+    for ( Size i = 0; i < count; ++i ) {
+        pairs[ i ] = Pair { examples::DepthSort::toKey( frames.current[ order[ i ] ] ), UInt32( i ) };
+    }
+}
+
+std::string toString( examples::DepthSort::Result result )
+{
+    switch ( result ) {
+        case examples::DepthSort::Result::UNCHANGED:
+            return "unchanged";
+        case examples::DepthSort::Result::INSERTION:
+            return "insertion";
+        case examples::DepthSort::Result::RADIX:
+            return "radix";
+    }
+    return "unknown";
+}
+
+int main( int argc, char **argv )
+{
+    Size roundCount = 5;
+    if ( argc > 1 ) {
+        try {
+            roundCount = std::max( Size( 1 ), Size( std::stoul( argv[ 1 ] ) ) );
+        } catch ( const std::exception & ) {
+            std::cout << "Usage: " << argv[ 0 ] << " [rounds]" << std::endl;
+            return 1;
+        }
+    }
+
+    crimild::concurrency::JobScheduler jobScheduler;
+    jobScheduler.configure();
+    jobScheduler.start();
+
+    using Clock = std::chrono::high_resolution_clock;
+    using Milliseconds = std::chrono::duration< double, std::milli >;
+
+    std::mt19937 rng( 1234 );
+    Size failures = 0;
+
+    std::cout << "Sorting particles back to front, best of " << roundCount << " rounds" << std::endl;
+
+    for ( auto count : { Size( 10000 ), Size( 100000 ), Size( 1000000 ) } ) {
+        for ( auto coherent : { true, false } ) {
+            const auto frames = makeFrames( count, coherent, rng );
+
+            std::vector< Pair > input;
+            fillPairs( frames, input );
+
+            examples::DepthSort sorter;
+            std::vector< Pair > reference;
+            auto result = examples::DepthSort::Result::UNCHANGED;
+            auto bestDepthSort = std::numeric_limits< double >::max();
+            auto bestStableSort = std::numeric_limits< double >::max();
+
+            for ( Size round = 0; round < roundCount; ++round ) {
+                sorter.getPairs() = input;
+                auto t0 = Clock::now();
+                result = sorter.sort();
+                auto t1 = Clock::now();
+                bestDepthSort = std::min( bestDepthSort, Milliseconds( t1 - t0 ).count() );
+
+                reference = input;
+                auto t2 = Clock::now();
+                std::stable_sort( reference.begin(), reference.end(), []( const Pair &a, const Pair &b ) { return a.key < b.key; } );
+                auto t3 = Clock::now();
+                bestStableSort = std::min( bestStableSort, Milliseconds( t3 - t2 ).count() );
+            }
+
+            // DepthSort is stable (both the insertion sort and the radix sort
+            // keep equal keys in order), so it must match the reference exactly
+            const auto &pairs = sorter.getPairs();
+            const auto matches = std::equal(
+                pairs.begin(),
+                pairs.end(),
+                reference.begin(),
+                reference.end(),
+                []( const Pair &a, const Pair &b ) {
+                    return a.key == b.key && a.index == b.index;
+                } );
+            if ( !matches ) {
+                ++failures;
+            }
+
+            std::cout << count << " particles (" << ( coherent ? "coherent" : "shuffled" ) << "): "
+                      << "DepthSort " << bestDepthSort << "ms (" << toString( result ) << "), "
+                      << "std::stable_sort " << bestStableSort << "ms"
+                      << std::endl;
+        }
+    }
+
+    jobScheduler.stop();
+
+    if ( failures > 0 ) {
+        std::cout << failures << " runs don't match std::stable_sort" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -27,8 +27,82 @@
 
 #include <Crimild.hpp>
 
+#include "DepthSort.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
 using namespace crimild;
 
+namespace crimild {
+
+    /**
+       \brief Particle positions at the start of the last fixed step
+
+       Used to interpolate rendered positions between fixed steps (see
+       FixedStepParticleUpdater). Entries are kept in the same order as
+       particles, so updaters that kill or reorder particles must mirror each
+       of their swaps here.
+     */
+    class ParticleHistory {
+    public:
+        /**
+           \brief Saves positions for all alive particles
+         */
+        void save( const Vector3f *positions, Size aliveCount ) noexcept
+        {
+            m_positions.resize( std::max( m_positions.size(), aliveCount ) );
+            std::copy( positions, positions + aliveCount, m_positions.begin() );
+            m_count = aliveCount;
+        }
+
+        /**
+           \brief Gives particles emitted since the last save no motion to interpolate
+         */
+        void extend( const Vector3f *positions, Size aliveCount ) noexcept
+        {
+            if ( aliveCount <= m_count ) {
+                return;
+            }
+            m_positions.resize( std::max( m_positions.size(), aliveCount ) );
+            std::copy( positions + m_count, positions + aliveCount, m_positions.begin() + m_count );
+            m_count = aliveCount;
+        }
+
+        void swap( Size a, Size b ) noexcept
+        {
+            std::swap( m_positions[ a ], m_positions[ b ] );
+        }
+
+        /**
+           \brief Mirrors ParticleData::kill(), which moves the last alive particle into i
+         */
+        void kill( Size i ) noexcept
+        {
+            if ( m_count > 0 ) {
+                m_positions[ i ] = m_positions[ m_count - 1 ];
+                --m_count;
+            }
+        }
+
+        inline const Vector3f *getPositions( void ) const noexcept { return m_positions.data(); }
+        inline Size getCount( void ) const noexcept { return m_count; }
+
+        /**
+           \brief How far rendering is between the last step and the next one, in [0, 1)
+         */
+        inline Real32 getAlpha( void ) const noexcept { return m_alpha; }
+        inline void setAlpha( Real32 alpha ) noexcept { m_alpha = alpha; }
+
+    private:
+        std::vector< Vector3f > m_positions;
+        Size m_count = 0;
+        Real32 m_alpha = 0;
+    };
+
+}
+
 namespace crimild {
 
     class CustomParticleRenderer : public ParticleSystemComponent::ParticleRenderer {
@@ -40,7 +114,12 @@ namespace crimild {
         };
 
     public:
-        CustomParticleRenderer( void ) noexcept
+        /**
+           \param history If not null, positions are interpolated from the
+           history up to the current ones
+         */
+        explicit CustomParticleRenderer( SharedPointer< ParticleHistory > const &history = nullptr ) noexcept
+            : m_history( history )
         {
         }
 
@@ -129,14 +208,15 @@ namespace crimild {
             m_positions = particles->getAttrib( ParticleAttrib::POSITION );
             m_colors = particles->getAttrib( ParticleAttrib::COLOR );
             m_sizes = particles->getAttrib( ParticleAttrib::UNIFORM_SCALE );
+
+            // Make sure every vertex starts flagged as dead
+            m_lastAliveCount = particles->getParticleCount();
         }
 
         virtual void update( Node *node, crimild::Real64 dt, ParticleData *particles ) override
         {
-            const auto N = particles->getParticleCount();
-
-            const auto pCount = particles->getAliveCount();
-            if ( pCount == 0 ) {
+            const Size pCount = particles->getAliveCount();
+            if ( pCount == 0 && m_lastAliveCount == 0 ) {
                 return;
             }
 
@@ -154,19 +234,843 @@ namespace crimild {
             // That's why setting a value for buffer view's length has no effect
             //m_vertices->getBufferView()->setLength( pCount );
 
-            for ( auto i = 0; i < N; i++ ) {
+            // The simulation only advances in fixed steps, so positions are blended
+            // from the start of the last step towards its end to keep motion smooth
+            // on frames that don't run a step. Particles emitted after that step
+            // have no history and use their current position.
+            const auto interpolated = m_history != nullptr ? std::min( m_history->getCount(), pCount ) : Size( 0 );
+            if ( interpolated > 0 ) {
+                const auto previous = m_history->getPositions();
+                const auto alpha = m_history->getAlpha();
+                for ( Size i = 0; i < interpolated; i++ ) {
+                    dstPositions->set( i, previous[ i ] + alpha * ( srcPositions[ i ] - previous[ i ] ) );
+                }
+            }
+
+            for ( Size i = interpolated; i < pCount; i++ ) {
                 dstPositions->set( i, srcPositions[ i ] );
+            }
+
+            // Only live particles are copied. Dead ones are hidden by the alive
+            // flag, and only those that died since the last frame need to have it
+            // cleared. Everything past that was already cleared before.
+            for ( Size i = 0; i < pCount; i++ ) {
                 dstColors->set( i, srcColors[ i ] );
                 dstSizes->set( i, srcSizes[ i ] );
-                dstAlive->set( i, Real32( i < pCount ? 1.0 : 0.0 ) );
+                dstAlive->set( i, Real32( 1 ) );
             }
+
+            for ( Size i = pCount; i < m_lastAliveCount; i++ ) {
+                dstAlive->set( i, Real32( 0 ) );
+            }
+
+            m_lastAliveCount = pCount;
         }
 
     private:
+        SharedPointer< ParticleHistory > m_history;
         SharedPointer< VertexBuffer > m_vertices;
         ParticleAttribArray *m_positions = nullptr;
         ParticleAttribArray *m_colors = nullptr;
         ParticleAttribArray *m_sizes = nullptr;
+        Size m_lastAliveCount = 0;
+    };
+
+}
+
+namespace crimild {
+
+    /**
+       \brief Euler, color and time updates fused in a single pass
+
+       Replaces the EulerParticleUpdater, ColorParticleUpdater and
+       TimeParticleUpdater sequence. Running them one after another means three
+       passes over every attribute array, plus a virtual call per updater.
+       Here, alive particles are split into chunks small enough to stay in
+       cache and all three steps run on a chunk before moving to the next one.
+
+       Within a chunk, each step is still a plain loop over floats. Vector3f and
+       RGBAColorf attributes are treated as flat arrays, so the loops have no
+       dependencies between iterations and can be vectorized (SSE/AVX/NEON).
+
+       Large emitters process chunks in parallel. Small ones do it in place,
+       since they're not worth the cost of dispatching jobs. Expired particles
+       are killed at the end, once every chunk is done.
+
+       Positions are integrated in closed form for constant accelerations and
+       colors depend only on the remaining time. Updaters that change
+       velocities in between (separation, collisions) do depend on the step
+       size, though, so they should share a FixedStepParticleUpdater with
+       this one.
+
+       If a history is given, kills are mirrored there so it stays aligned
+       with particles.
+     */
+    class FusedParticleUpdater : public ParticleSystemComponent::ParticleUpdater {
+        CRIMILD_IMPLEMENT_RTTI( FusedParticleUpdater )
+
+        static_assert( sizeof( Vector3f ) == 3 * sizeof( Real32 ), "Vector3f must be tightly packed" );
+        static_assert( sizeof( RGBAColorf ) == 4 * sizeof( Real32 ), "RGBAColorf must be tightly packed" );
+
+        // In particles
+        static constexpr Size CHUNK_SIZE = 4096;
+
+        struct Streams {
+            Real32 *positions;
+            Real32 *velocities;
+            const Real32 *accelerations;
+            Real32 *colors;
+            const Real32 *startColors;
+            const Real32 *endColors;
+            Real32 *times;
+            const Real32 *lifeTimes;
+        };
+
+    public:
+        explicit FusedParticleUpdater( SharedPointer< ParticleHistory > const &history = nullptr ) noexcept
+            : m_history( history )
+        {
+        }
+
+        ~FusedParticleUpdater( void ) = default;
+
+        virtual void configure( Node *node, ParticleData *particles ) override
+        {
+            m_positions = particles->getAttrib( ParticleAttrib::POSITION );
+            m_velocities = particles->getAttrib( ParticleAttrib::VELOCITY );
+            m_accelerations = particles->getAttrib( ParticleAttrib::ACCELERATION );
+            m_colors = particles->getAttrib( ParticleAttrib::COLOR );
+            m_startColors = particles->getAttrib( ParticleAttrib::START_COLOR );
+            m_endColors = particles->getAttrib( ParticleAttrib::END_COLOR );
+            m_times = particles->getAttrib( ParticleAttrib::TIME );
+            m_lifeTimes = particles->getAttrib( ParticleAttrib::LIFE_TIME );
+        }
+
+        virtual void update( Node *node, crimild::Real64 dt, ParticleData *particles ) override
+        {
+            const Size count = particles->getAliveCount();
+            if ( count == 0 ) {
+                return;
+            }
+
+            const auto streams = Streams {
+                .positions = reinterpret_cast< Real32 * >( m_positions->getData< Vector3f >() ),
+                .velocities = reinterpret_cast< Real32 * >( m_velocities->getData< Vector3f >() ),
+                .accelerations = reinterpret_cast< const Real32 * >( m_accelerations->getData< Vector3f >() ),
+                .colors = reinterpret_cast< Real32 * >( m_colors->getData< RGBAColorf >() ),
+                .startColors = reinterpret_cast< const Real32 * >( m_startColors->getData< RGBAColorf >() ),
+                .endColors = reinterpret_cast< const Real32 * >( m_endColors->getData< RGBAColorf >() ),
+                .times = m_times->getData< Real32 >(),
+                .lifeTimes = m_lifeTimes->getData< Real32 >(),
+            };
+            const auto h = Real32( dt );
+
+            if ( count <= CHUNK_SIZE ) {
+                updateChunk( streams, h, 0, count );
+            } else {
+                auto parent = crimild::concurrency::async();
+                for ( Size begin = 0; begin < count; begin += CHUNK_SIZE ) {
+                    const auto end = std::min( begin + CHUNK_SIZE, count );
+                    crimild::concurrency::async( parent, [ streams, h, begin, end ]() {
+                        updateChunk( streams, h, begin, end );
+                    } );
+                }
+                crimild::concurrency::wait( parent );
+            }
+
+            // Killing a particle swaps it with the last alive one. Going backwards
+            // means that particle has already been checked.
+            for ( auto i = count; i > 0; --i ) {
+                if ( streams.times[ i - 1 ] <= 0.0f ) {
+                    particles->kill( i - 1 );
+                    if ( m_history != nullptr ) {
+                        m_history->kill( i - 1 );
+                    }
+                }
+            }
+        }
+
+    private:
+        static void updateChunk( const Streams &streams, Real32 h, Size begin, Size end ) noexcept
+        {
+            integrate( streams.positions + 3 * begin, streams.velocities + 3 * begin, streams.accelerations + 3 * begin, h, 3 * ( end - begin ) );
+            // Colors are computed after advancing time, so they match the
+            // particle state at the end of the step no matter its size
+            tick( streams.times + begin, h, end - begin );
+            interpolateColors( streams.colors + 4 * begin, streams.startColors + 4 * begin, streams.endColors + 4 * begin, streams.times + begin, streams.lifeTimes + begin, end - begin );
+        }
+
+        static void integrate( Real32 *__restrict p, Real32 *__restrict v, const Real32 *__restrict a, Real32 h, Size count ) noexcept
+        {
+            // Exact for constant accelerations: p' = p + v * h + a * h^2 / 2
+            const auto hh = 0.5f * h * h;
+            for ( Size i = 0; i < count; ++i ) {
+                p[ i ] += h * v[ i ] + hh * a[ i ];
+            }
+
+            for ( Size i = 0; i < count; ++i ) {
+                v[ i ] += h * a[ i ];
+            }
+        }
+
+        static void tick( Real32 *__restrict t, Real32 h, Size count ) noexcept
+        {
+            for ( Size i = 0; i < count; ++i ) {
+                t[ i ] -= h;
+            }
+        }
+
+        static void interpolateColors( Real32 *__restrict c, const Real32 *__restrict c0, const Real32 *__restrict c1, const Real32 *__restrict t, const Real32 *__restrict lifeTimes, Size count ) noexcept
+        {
+            // Time counts down, so colors go from start to end as it approaches zero
+            for ( Size i = 0; i < count; ++i ) {
+                const auto s = 1.0f - t[ i ] / lifeTimes[ i ];
+                for ( Size j = 4 * i; j < 4 * i + 4; ++j ) {
+                    c[ j ] = c0[ j ] + s * ( c1[ j ] - c0[ j ] );
+                }
+            }
+        }
+
+        SharedPointer< ParticleHistory > m_history;
+        ParticleAttribArray *m_positions = nullptr;
+        ParticleAttribArray *m_velocities = nullptr;
+        ParticleAttribArray *m_accelerations = nullptr;
+        ParticleAttribArray *m_colors = nullptr;
+        ParticleAttribArray *m_startColors = nullptr;
+        ParticleAttribArray *m_endColors = nullptr;
+        ParticleAttribArray *m_times = nullptr;
+        ParticleAttribArray *m_lifeTimes = nullptr;
+    };
+
+}
+
+namespace crimild {
+
+    /**
+       \brief Sorts particles back to front using a radix sort
+
+       Alternative to CameraSortParticleUpdater. Instead of comparing particles
+       against each other, each particle gets a 32-bit key from its distance to
+       the camera and (key, index) pairs are sorted by examples::DepthSort.
+       The resulting permutation is then applied to all attributes at once,
+       following each cycle with a single swap per particle.
+
+       Particles rarely change places from one frame to the next, so pairs are
+       kept in last frame's order and DepthSort tries a bounded insertion sort
+       before falling back to a radix sort.
+
+       If a history is given, swaps are mirrored there so it stays aligned
+       with particles.
+     */
+    class RadixSortParticleUpdater : public ParticleSystemComponent::ParticleUpdater {
+        CRIMILD_IMPLEMENT_RTTI( RadixSortParticleUpdater )
+
+    public:
+        explicit RadixSortParticleUpdater( SharedPointer< ParticleHistory > const &history = nullptr ) noexcept
+            : m_history( history )
+        {
+        }
+
+        ~RadixSortParticleUpdater( void ) = default;
+
+        virtual void configure( Node *node, ParticleData *particles ) override
+        {
+            m_positions = particles->getAttrib( ParticleAttrib::POSITION );
+        }
+
+        virtual void update( Node *node, crimild::Real64 dt, ParticleData *particles ) override
+        {
+            const Size count = particles->getAliveCount();
+            if ( count < 2 ) {
+                return;
+            }
+
+            auto camera = Camera::getMainCamera();
+            if ( camera == nullptr ) {
+                return;
+            }
+
+            auto eye = camera->getWorld().getTranslate();
+            if ( !particles->shouldComputeInWorldSpace() ) {
+                auto localEye = eye;
+                node->getWorld().applyInverseToPoint( eye, localEye );
+                eye = localEye;
+            }
+
+            // Particles were left sorted by the previous update, so the identity
+            // is last frame's order. Only keys need to be recomputed.
+            const auto positions = m_positions->getData< Vector3f >();
+            auto &pairs = m_sort.getPairs();
+            pairs.resize( count );
+            for ( Size i = 0; i < count; ++i ) {
+                pairs[ i ] = examples::DepthSort::Pair {
+                    examples::DepthSort::toKey( Distance::compute( eye, positions[ i ] ) ),
+                    UInt32( i ),
+                };
+            }
+
+            if ( m_sort.sort() == examples::DepthSort::Result::UNCHANGED ) {
+                return;
+            }
+
+            applyPermutation( particles );
+        }
+
+    private:
+        /**
+           \brief Moves particles to their sorted positions
+
+           After sorting, the particle that goes to position i is pairs[ i ].index.
+           Each cycle of that permutation is resolved with one swap per particle,
+           which moves every attribute at once.
+         */
+        void applyPermutation( ParticleData *particles ) noexcept
+        {
+            const auto &pairs = m_sort.getPairs();
+            const auto count = pairs.size();
+            m_visited.assign( count, false );
+            for ( Size i = 0; i < count; ++i ) {
+                if ( m_visited[ i ] ) {
+                    continue;
+                }
+                auto current = i;
+                while ( true ) {
+                    m_visited[ current ] = true;
+                    const Size next = pairs[ current ].index;
+                    if ( next == i ) {
+                        break;
+                    }
+                    particles->swap( current, next );
+                    if ( m_history != nullptr ) {
+                        m_history->swap( current, next );
+                    }
+                    current = next;
+                }
+            }
+        }
+
+        SharedPointer< ParticleHistory > m_history;
+        ParticleAttribArray *m_positions = nullptr;
+        examples::DepthSort m_sort;
+        std::vector< Bool > m_visited;
+    };
+
+}
+
+namespace crimild {
+
+    /**
+       \brief Spatial hash grid for particle neighbor queries
+
+       Rebuilt every frame. Particles are bucketed by the hash of the grid cell
+       they're in by sorting (bucket, index) pairs with a DepthSort. Pairs are
+       kept in last frame's order, and since particles rarely change cells
+       from one frame to the next, that's usually a cheap insertion sort. Both
+       hashing and finding where buckets start are done in parallel chunks for
+       large inputs, as are the radix passes when the insertion sort gives up.
+       Finding neighbors only visits the 27 cells around a point.
+
+       Different cells may share a bucket. That's fine as long as queries check
+       actual distances, which they have to do anyway, and visit each bucket
+       only once.
+     */
+    class SpatialHashGrid {
+        static constexpr Size CHUNK_SIZE = 16384;
+
+    public:
+        explicit SpatialHashGrid( Real32 cellSize ) noexcept
+            : m_cellSize( cellSize )
+        {
+        }
+
+        void build( const Real32 *positions, Size count ) noexcept
+        {
+            m_positions = positions;
+
+            // At least twice as many buckets as particles, so most of them hold
+            // a single cell. Power of two so the hash can be masked.
+            Size bucketCount = 64;
+            while ( bucketCount < 2 * count ) {
+                bucketCount <<= 1;
+            }
+            m_mask = bucketCount - 1;
+
+            // Keep last frame's order for particles that are still alive and
+            // append the new ones at the end
+            auto &pairs = m_sort.getPairs();
+            pairs.erase(
+                std::remove_if(
+                    pairs.begin(),
+                    pairs.end(),
+                    [ count ]( const examples::DepthSort::Pair &pair ) {
+                        return pair.index >= count;
+                    } ),
+                pairs.end() );
+            for ( auto i = pairs.size(); i < count; ++i ) {
+                pairs.push_back( { 0, UInt32( i ) } );
+            }
+
+            forEachRange(
+                count,
+                [ this, &pairs ]( Size begin, Size end ) {
+                    for ( auto k = begin; k < end; ++k ) {
+                        const auto p = m_positions + 3 * pairs[ k ].index;
+                        pairs[ k ].key = bucket( cell( p[ 0 ] ), cell( p[ 1 ] ), cell( p[ 2 ] ) );
+                    }
+                } );
+
+            m_sort.sort();
+
+            // Each bucket starts at the first pair whose key is not smaller.
+            // Every bucket is written by exactly one chunk, the one holding
+            // that pair, so chunks don't need to synchronize.
+            m_bucketStart.resize( bucketCount + 1 );
+            forEachRange(
+                count,
+                [ this, &pairs ]( Size begin, Size end ) {
+                    for ( auto k = begin; k < end; ++k ) {
+                        const auto first = k == 0 ? 0 : pairs[ k - 1 ].key + 1;
+                        for ( auto b = first; b <= pairs[ k ].key; ++b ) {
+                            m_bucketStart[ b ] = UInt32( k );
+                        }
+                    }
+                } );
+
+            const auto last = count == 0 ? 0 : pairs[ count - 1 ].key + 1;
+            for ( Size b = last; b <= bucketCount; ++b ) {
+                m_bucketStart[ b ] = UInt32( count );
+            }
+        }
+
+        /**
+           \brief Invokes fn( index, distance ) for every particle within radius of p
+
+           The radius must not be larger than the cell size. Safe to call from
+           multiple threads once the grid is built.
+         */
+        template< typename Fn >
+        void forEachNeighbor( const Real32 *p, Real32 radius, Fn fn ) const noexcept
+        {
+            const auto cx = cell( p[ 0 ] );
+            const auto cy = cell( p[ 1 ] );
+            const auto cz = cell( p[ 2 ] );
+            const auto r2 = radius * radius;
+            const auto &pairs = m_sort.getPairs();
+
+            // Neighbor cells may hash to the same bucket. Visit each bucket once
+            UInt32 visited[ 27 ];
+            Size visitedCount = 0;
+
+            for ( auto z = cz - 1; z <= cz + 1; ++z ) {
+                for ( auto y = cy - 1; y <= cy + 1; ++y ) {
+                    for ( auto x = cx - 1; x <= cx + 1; ++x ) {
+                        const auto b = bucket( x, y, z );
+                        if ( std::find( visited, visited + visitedCount, b ) != visited + visitedCount ) {
+                            continue;
+                        }
+                        visited[ visitedCount++ ] = b;
+
+                        for ( auto k = m_bucketStart[ b ]; k < m_bucketStart[ b + 1 ]; ++k ) {
+                            const auto j = pairs[ k ].index;
+                            const auto q = m_positions + 3 * j;
+                            const auto dx = p[ 0 ] - q[ 0 ];
+                            const auto dy = p[ 1 ] - q[ 1 ];
+                            const auto dz = p[ 2 ] - q[ 2 ];
+                            const auto d2 = dx * dx + dy * dy + dz * dz;
+                            if ( d2 < r2 ) {
+                                fn( j, std::sqrt( d2 ) );
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+    private:
+        Int32 cell( Real32 x ) const noexcept
+        {
+            return Int32( std::floor( x / m_cellSize ) );
+        }
+
+        UInt32 bucket( Int32 x, Int32 y, Int32 z ) const noexcept
+        {
+            return ( UInt32( x ) * 73856093u ^ UInt32( y ) * 19349663u ^ UInt32( z ) * 83492791u ) & m_mask;
+        }
+
+        template< typename Fn >
+        static void forEachRange( Size count, Fn fn ) noexcept
+        {
+            if ( count <= CHUNK_SIZE ) {
+                fn( 0, count );
+                return;
+            }
+
+            auto parent = crimild::concurrency::async();
+            for ( Size begin = 0; begin < count; begin += CHUNK_SIZE ) {
+                const auto end = std::min( begin + CHUNK_SIZE, count );
+                crimild::concurrency::async( parent, [ fn, begin, end ]() {
+                    fn( begin, end );
+                } );
+            }
+            crimild::concurrency::wait( parent );
+        }
+
+    private:
+        Real32 m_cellSize;
+        UInt32 m_mask = 0;
+        const Real32 *m_positions = nullptr;
+        examples::DepthSort m_sort;
+        std::vector< UInt32 > m_bucketStart;
+    };
+
+    /**
+       \brief Pushes particles away from their neighbors
+
+       Each particle is pushed away from every other particle closer than the
+       given radius, with a strength that falls linearly to zero at the radius.
+       Neighbors are found with a SpatialHashGrid, so the cost is linear in the
+       number of particles instead of quadratic.
+
+       Particles only read positions and write their own velocity, so large
+       emitters are updated in parallel chunks.
+     */
+    class SeparationParticleUpdater : public ParticleSystemComponent::ParticleUpdater {
+        CRIMILD_IMPLEMENT_RTTI( SeparationParticleUpdater )
+
+        static constexpr Size CHUNK_SIZE = 4096;
+
+    public:
+        SeparationParticleUpdater( Real32 radius, Real32 strength ) noexcept
+            : m_radius( radius ),
+              m_strength( strength ),
+              m_grid( radius )
+        {
+        }
+
+        ~SeparationParticleUpdater( void ) = default;
+
+        virtual void configure( Node *node, ParticleData *particles ) override
+        {
+            m_positions = particles->getAttrib( ParticleAttrib::POSITION );
+            m_velocities = particles->getAttrib( ParticleAttrib::VELOCITY );
+        }
+
+        virtual void update( Node *node, crimild::Real64 dt, ParticleData *particles ) override
+        {
+            const Size count = particles->getAliveCount();
+            if ( count < 2 ) {
+                return;
+            }
+
+            const auto p = reinterpret_cast< const Real32 * >( m_positions->getData< Vector3f >() );
+            const auto v = reinterpret_cast< Real32 * >( m_velocities->getData< Vector3f >() );
+            const auto k = m_strength * Real32( dt );
+
+            m_grid.build( p, count );
+
+            auto separate = [ this, p, v, k ]( Size begin, Size end ) {
+                for ( auto i = begin; i < end; ++i ) {
+                    const auto pi = p + 3 * i;
+                    auto vi = v + 3 * i;
+                    m_grid.forEachNeighbor(
+                        pi,
+                        m_radius,
+                        [ & ]( UInt32 j, Real32 d ) {
+                            if ( j == i || d == 0.0f ) {
+                                return;
+                            }
+                            const auto s = k * ( 1.0f - d / m_radius ) / d;
+                            const auto pj = p + 3 * j;
+                            vi[ 0 ] += s * ( pi[ 0 ] - pj[ 0 ] );
+                            vi[ 1 ] += s * ( pi[ 1 ] - pj[ 1 ] );
+                            vi[ 2 ] += s * ( pi[ 2 ] - pj[ 2 ] );
+                        } );
+                }
+            };
+
+            if ( count <= CHUNK_SIZE ) {
+                separate( 0, count );
+                return;
+            }
+
+            auto parent = crimild::concurrency::async();
+            for ( Size begin = 0; begin < count; begin += CHUNK_SIZE ) {
+                const auto end = std::min( begin + CHUNK_SIZE, count );
+                crimild::concurrency::async( parent, [ separate, begin, end ]() {
+                    separate( begin, end );
+                } );
+            }
+            crimild::concurrency::wait( parent );
+        }
+
+    private:
+        Real32 m_radius;
+        Real32 m_strength;
+        SpatialHashGrid m_grid;
+        ParticleAttribArray *m_positions = nullptr;
+        ParticleAttribArray *m_velocities = nullptr;
+    };
+
+    /**
+       \brief Keeps particles out of planes, spheres and boxes
+
+       Particles found behind a plane or inside a sphere or a box are moved back
+       to the surface and the normal component of their velocity is reflected, scaled
+       by the restitution factor. Colliders are given in the particle system's
+       space.
+     */
+    class CollisionParticleUpdater : public ParticleSystemComponent::ParticleUpdater {
+        CRIMILD_IMPLEMENT_RTTI( CollisionParticleUpdater )
+
+    private:
+        struct Plane {
+            Real32 normal[ 3 ];
+            Real32 offset;
+        };
+
+        struct Sphere {
+            Real32 center[ 3 ];
+            Real32 radius;
+        };
+
+        struct Box {
+            Real32 min[ 3 ];
+            Real32 max[ 3 ];
+        };
+
+    public:
+        explicit CollisionParticleUpdater( Real32 restitution = 0.5f ) noexcept
+            : m_restitution( restitution )
+        {
+        }
+
+        ~CollisionParticleUpdater( void ) = default;
+
+        /**
+           \brief Adds a plane with points p such that dot( p, normal ) = offset
+
+           The normal must be unit length and points to the allowed side.
+         */
+        void addPlane( Real32 nx, Real32 ny, Real32 nz, Real32 offset ) noexcept
+        {
+            m_planes.push_back( Plane { { nx, ny, nz }, offset } );
+        }
+
+        void addSphere( Real32 cx, Real32 cy, Real32 cz, Real32 radius ) noexcept
+        {
+            m_spheres.push_back( Sphere { { cx, cy, cz }, radius } );
+        }
+
+        /**
+           \brief Adds an axis-aligned box
+
+           Particles inside the box are pushed out through the closest face.
+         */
+        void addBox( Real32 minX, Real32 minY, Real32 minZ, Real32 maxX, Real32 maxY, Real32 maxZ ) noexcept
+        {
+            m_boxes.push_back( Box { { minX, minY, minZ }, { maxX, maxY, maxZ } } );
+        }
+
+        virtual void configure( Node *node, ParticleData *particles ) override
+        {
+            m_positions = particles->getAttrib( ParticleAttrib::POSITION );
+            m_velocities = particles->getAttrib( ParticleAttrib::VELOCITY );
+        }
+
+        virtual void update( Node *node, crimild::Real64 dt, ParticleData *particles ) override
+        {
+            const Size count = particles->getAliveCount();
+            const auto p = reinterpret_cast< Real32 * >( m_positions->getData< Vector3f >() );
+            const auto v = reinterpret_cast< Real32 * >( m_velocities->getData< Vector3f >() );
+
+            for ( Size i = 0; i < count; ++i ) {
+                auto pi = p + 3 * i;
+                auto vi = v + 3 * i;
+
+                for ( const auto &plane : m_planes ) {
+                    const auto n = plane.normal;
+                    const auto d = pi[ 0 ] * n[ 0 ] + pi[ 1 ] * n[ 1 ] + pi[ 2 ] * n[ 2 ] - plane.offset;
+                    if ( d < 0.0f ) {
+                        resolve( pi, vi, n, -d );
+                    }
+                }
+
+                for ( const auto &sphere : m_spheres ) {
+                    const Real32 delta[ 3 ] = {
+                        pi[ 0 ] - sphere.center[ 0 ],
+                        pi[ 1 ] - sphere.center[ 1 ],
+                        pi[ 2 ] - sphere.center[ 2 ],
+                    };
+                    const auto d = std::sqrt( delta[ 0 ] * delta[ 0 ] + delta[ 1 ] * delta[ 1 ] + delta[ 2 ] * delta[ 2 ] );
+                    if ( d < sphere.radius && d > 0.0f ) {
+                        const Real32 n[ 3 ] = { delta[ 0 ] / d, delta[ 1 ] / d, delta[ 2 ] / d };
+                        resolve( pi, vi, n, sphere.radius - d );
+                    }
+                }
+
+                for ( const auto &box : m_boxes ) {
+                    if ( !isInside( pi, box ) ) {
+                        continue;
+                    }
+
+                    // Find the face with the least penetration
+                    Size axis = 0;
+                    Real32 sign = -1.0f;
+                    Real32 depth = pi[ 0 ] - box.min[ 0 ];
+                    for ( Size k = 0; k < 3; ++k ) {
+                        const auto toMin = pi[ k ] - box.min[ k ];
+                        const auto toMax = box.max[ k ] - pi[ k ];
+                        if ( toMin < depth ) {
+                            axis = k;
+                            sign = -1.0f;
+                            depth = toMin;
+                        }
+                        if ( toMax < depth ) {
+                            axis = k;
+                            sign = 1.0f;
+                            depth = toMax;
+                        }
+                    }
+
+                    Real32 n[ 3 ] = { 0.0f, 0.0f, 0.0f };
+                    n[ axis ] = sign;
+                    resolve( pi, vi, n, depth );
+                }
+            }
+        }
+
+    private:
+        static Bool isInside( const Real32 *p, const Box &box ) noexcept
+        {
+            return p[ 0 ] > box.min[ 0 ] && p[ 0 ] < box.max[ 0 ]
+                   && p[ 1 ] > box.min[ 1 ] && p[ 1 ] < box.max[ 1 ]
+                   && p[ 2 ] > box.min[ 2 ] && p[ 2 ] < box.max[ 2 ];
+        }
+
+        void resolve( Real32 *p, Real32 *v, const Real32 *n, Real32 depth ) const noexcept
+        {
+            p[ 0 ] += depth * n[ 0 ];
+            p[ 1 ] += depth * n[ 1 ];
+            p[ 2 ] += depth * n[ 2 ];
+
+            const auto vn = v[ 0 ] * n[ 0 ] + v[ 1 ] * n[ 1 ] + v[ 2 ] * n[ 2 ];
+            if ( vn < 0.0f ) {
+                const auto s = ( 1.0f + m_restitution ) * vn;
+                v[ 0 ] -= s * n[ 0 ];
+                v[ 1 ] -= s * n[ 1 ];
+                v[ 2 ] -= s * n[ 2 ];
+            }
+        }
+
+    private:
+        Real32 m_restitution;
+        std::vector< Plane > m_planes;
+        std::vector< Sphere > m_spheres;
+        std::vector< Box > m_boxes;
+        ParticleAttribArray *m_positions = nullptr;
+        ParticleAttribArray *m_velocities = nullptr;
+    };
+
+}
+
+namespace crimild {
+
+    /**
+       \brief Runs a sequence of updaters on a fixed time step
+
+       Time is accumulated and every updater is invoked, in order, once for
+       each full step. Updaters whose results depend on the step size, and
+       those that depend on their results, must all be added to the same
+       FixedStepParticleUpdater. Otherwise, positions would not advance
+       between the substeps of the others.
+
+       The simulation is always up to one step behind, since the remainder is
+       kept for the next frame. If a history is given, positions are saved
+       there before each step, along with how far into the next step the
+       frame is (alpha), so a renderer can blend between the last two steps
+       instead of stuttering on frames that don't run any.
+
+       When more than the maximum number of steps are pending, as when
+       pre-warming the system, they're merged into that many larger steps
+       instead. That keeps fast-forwarding cheap, at the cost of results
+       that no longer match the ones at the regular step.
+     */
+    class FixedStepParticleUpdater : public ParticleSystemComponent::ParticleUpdater {
+        CRIMILD_IMPLEMENT_RTTI( FixedStepParticleUpdater )
+
+    public:
+        explicit FixedStepParticleUpdater( SharedPointer< ParticleHistory > const &history = nullptr, Real64 step = 1.0 / 60.0, Size maxSteps = 8 ) noexcept
+            : m_history( history ),
+              m_step( step ),
+              m_maxSteps( maxSteps )
+        {
+        }
+
+        ~FixedStepParticleUpdater( void ) = default;
+
+        void addUpdater( SharedPointer< ParticleSystemComponent::ParticleUpdater > const &updater ) noexcept
+        {
+            m_updaters.push_back( updater );
+        }
+
+        virtual void configure( Node *node, ParticleData *particles ) override
+        {
+            m_positions = particles->getAttrib( ParticleAttrib::POSITION );
+            for ( auto &updater : m_updaters ) {
+                updater->configure( node, particles );
+            }
+        }
+
+        virtual void update( Node *node, crimild::Real64 dt, ParticleData *particles ) override
+        {
+            m_accumulator += dt;
+
+            const auto steps = Size( m_accumulator / m_step );
+            if ( steps > m_maxSteps ) {
+                const auto h = m_accumulator / Real64( m_maxSteps );
+                for ( Size i = 0; i < m_maxSteps; ++i ) {
+                    step( node, h, particles );
+                }
+                m_accumulator = 0;
+
+                // Nothing is pending, so there's nothing to blend from
+                if ( m_history != nullptr ) {
+                    m_history->save( m_positions->getData< Vector3f >(), particles->getAliveCount() );
+                    m_history->setAlpha( 0 );
+                }
+                return;
+            }
+
+            for ( Size i = 0; i < steps; ++i ) {
+                step( node, m_step, particles );
+            }
+            m_accumulator -= Real64( steps ) * m_step;
+
+            if ( m_history != nullptr ) {
+                m_history->extend( m_positions->getData< Vector3f >(), particles->getAliveCount() );
+                m_history->setAlpha( Real32( m_accumulator / m_step ) );
+            }
+        }
+
+    private:
+        void step( Node *node, Real64 h, ParticleData *particles )
+        {
+            if ( m_history != nullptr ) {
+                m_history->save( m_positions->getData< Vector3f >(), particles->getAliveCount() );
+            }
+
+            for ( auto &updater : m_updaters ) {
+                updater->update( node, h, particles );
+            }
+        }
+
+    private:
+        SharedPointer< ParticleHistory > m_history;
+        std::vector< SharedPointer< ParticleSystemComponent::ParticleUpdater > > m_updaters;
+        Real64 m_step;
+        Size m_maxSteps;
+        Real64 m_accumulator = 0;
+        ParticleAttribArray *m_positions = nullptr;
     };
 
 }
@@ -353,11 +1257,17 @@ public:
 
                 scene->attachNode(
                     [] {
+                        // Use the "particles" setting to stress the simulation with larger emitters
+                        const auto maxParticles = Simulation::getInstance()->getSettings()->get< Int32 >( "particles", 500 );
+
                         auto fire = crimild::alloc< Group >();
-                        auto ps = fire->attachComponent< ParticleSystemComponent >( 500 );
+                        auto ps = fire->attachComponent< ParticleSystemComponent >( maxParticles );
                         ps->setPreWarmTime( 1.0 );
-                        ps->setEmitRate( 200 );
-                        ps->addGenerator< BoxPositionParticleGenerator >( Vector3f::ZERO, Vector3f( 0.5f, 0.25f, 0.5f ) );
+                        ps->setEmitRate( 0.4f * maxParticles );
+
+                        // The sphere below the fire reaches up to y = 0.5. Particles spawn right
+                        // above it, so they don't start inside a collider.
+                        ps->addGenerator< BoxPositionParticleGenerator >( Vector3f( 0.0f, 0.75f, 0.0f ), Vector3f( 0.5f, 0.25f, 0.5f ) );
                         ps->addGenerator< RandomVector3fParticleGenerator >( ParticleAttrib::VELOCITY, Vector3f( 0.0f, 0.25f, 0.0f ), Vector3f( 0.2f, 1.0f, 0.2f ) );
                         ps->addGenerator(
                             [] {
@@ -391,12 +1301,50 @@ public:
                                 return generator;
                             }() );
 
-                        ps->addUpdater( crimild::alloc< EulerParticleUpdater >() );
-                        ps->addUpdater( crimild::alloc< ColorParticleUpdater >() );
-                        ps->addUpdater( crimild::alloc< TimeParticleUpdater >() );
-                        ps->addUpdater( crimild::alloc< CameraSortParticleUpdater >() );
+                        // Separation, integration and collisions all depend on each other's
+                        // results, so they advance together on the same fixed step. Positions
+                        // at the start of the last step are kept in the history, which the
+                        // renderer uses to blend towards the current ones.
+                        auto history = crimild::alloc< ParticleHistory >();
+                        ps->addUpdater(
+                            [ history ] {
+                                auto updater = crimild::alloc< FixedStepParticleUpdater >( history );
+                                updater->addUpdater( crimild::alloc< SeparationParticleUpdater >( 0.1f, 2.0f ) );
+                                updater->addUpdater( crimild::alloc< FusedParticleUpdater >( history ) );
+                                updater->addUpdater(
+                                    [] {
+                                        // Same as the ground quad and the sphere in the scene. The fire
+                                        // node is at the origin, so particle and world space match.
+                                        auto collision = crimild::alloc< CollisionParticleUpdater >();
+                                        collision->addBox( -15.0f, -1.0f, -15.0f, 15.0f, 0.0f, 15.0f );
+                                        collision->addSphere( 0.0f, -3.5f, 0.0f, 4.0f );
+                                        return collision;
+                                    }() );
+                                return updater;
+                            }() );
+                        ps->addUpdater( crimild::alloc< RadixSortParticleUpdater >( history ) );
+
+                        ps->addRenderer( crimild::alloc< CustomParticleRenderer >( history ) );
+
+                        // Emission LOD. The fire covers fewer pixels the farther it is from
+                        // the camera (its projected area shrinks with the square of the
+                        // distance), so fewer particles are needed for it to look the same.
+                        // Since particles have a limited life time, lowering the emit rate
+                        // also lowers the number of alive particles to simulate and draw.
+                        fire->attachComponent< LambdaComponent >(
+                            [ ps, emitRate = 0.4f * maxParticles ]( auto node, auto &clock ) {
+                                const auto FULL_DETAIL_DISTANCE = 10.0f;
+                                const auto MIN_EMIT_SCALE = 0.05f;
 
-                        ps->addRenderer( crimild::alloc< CustomParticleRenderer >() );
+                                auto camera = Camera::getMainCamera();
+                                if ( camera == nullptr ) {
+                                    return;
+                                }
+
+                                const auto d = Distance::compute( camera->getWorld().getTranslate(), node->getWorld().getTranslate() );
+                                const auto r = d > FULL_DETAIL_DISTANCE ? FULL_DETAIL_DISTANCE / d : 1.0f;
+                                ps->setEmitRate( std::max( MIN_EMIT_SCALE, r * r ) * emitRate );
+                            } );
 
                         return fire;
                     }() );
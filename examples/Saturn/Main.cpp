@@ -27,6 +27,10 @@
 
 #include <Crimild.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
 using namespace crimild;
 
 #define OPTION_NO_INSTANCING 0
@@ -76,13 +80,32 @@ SharedPointer< Node > buildAsteroids( int options )
 
     auto group = crimild::alloc< Group >();
 
-    crimild::Size count = 1000;
+    // Use the "asteroids" setting to try larger belts
+    const crimild::Size count = std::max( 0, Simulation::getInstance()->getSettings()->get< crimild::Int32 >( "asteroids", 1000 ) );
 
     auto radius = 50.0f;
     auto offset = 10.0f;
 
     auto material = crimild::alloc< materials::PrincipledBSDF >();
 
+    // Asteroids only differ in their transformation. Instead of cloning the
+    // model's hierarchy with ShallowCopy (which duplicates every node, component
+    // and material), each asteroid is a single Geometry referencing the
+    // model's primitives and materials directly.
+    model->perform( UpdateWorldState() );
+    Array< Geometry * > sources;
+    model->perform( ApplyToGeometries( [ & ]( Geometry *g ) { sources.add( g ); } ) );
+
+    // The rock model is not centered at its origin, so each asteroid's
+    // bounding sphere is the model's bound moved by its transformation.
+    const auto modelCenter = model->getWorldBound()->getCenter();
+    const auto modelRadius = model->getWorldBound()->getRadius();
+
+    std::vector< crimild::Real32 > centers( 3 * count );
+    std::vector< crimild::Real32 > radii( count );
+    std::vector< Node * > nodes;
+    nodes.reserve( count * sources.size() );
+
     for ( crimild::Size i = 0; i < count; ++i ) {
         // Transformation t;
 
@@ -101,16 +124,81 @@ SharedPointer< Node > buildAsteroids( int options )
 
         const auto T = translation( x, y, z ) * rotation( normalize( Vector3 { 0.4, 0.8, 0.6 } ), angle ) * scale( s );
 
-        ShallowCopy copy;
-        model->perform( copy );
-        auto asteroid = copy.getResult< Node >();
-        // auto asteroid = crimild::alloc< Geometry >();
-        // asteroid->attachPrimitive( SpherePrimitive::UNIT_SPHERE );
-        // asteroid->attachComponent< MaterialComponent >( material );
-        asteroid->setLocal( T );
-        group->attachNode( asteroid );
+        const auto center = T( modelCenter );
+        centers[ 3 * i + 0 ] = center.x;
+        centers[ 3 * i + 1 ] = center.y;
+        centers[ 3 * i + 2 ] = center.z;
+        radii[ i ] = s * modelRadius;
+
+        sources.each(
+            [ & ]( Geometry *source ) {
+                auto asteroid = crimild::alloc< Geometry >();
+                source->forEachPrimitive(
+                    [ & ]( Primitive *p ) {
+                        asteroid->attachPrimitive( crimild::retain( p ) );
+                    } );
+                if ( auto ms = source->getComponent< MaterialComponent >() ) {
+                    if ( auto m = ms->first() ) {
+                        asteroid->attachComponent< MaterialComponent >( crimild::retain( m ) );
+                    }
+                }
+                // auto asteroid = crimild::alloc< Geometry >();
+                // asteroid->attachPrimitive( SpherePrimitive::UNIT_SPHERE );
+                // asteroid->attachComponent< MaterialComponent >( material );
+                asteroid->setLocal( T * source->getWorld() );
+                nodes.push_back( crimild::get_ptr( asteroid ) );
+                group->attachNode( asteroid );
+            } );
     }
 
+    // Most asteroids in a large belt end up covering less than a pixel. Those
+    // are disabled so they are neither updated nor drawn. Bounding spheres live
+    // in flat arrays and the test has no square roots or branches, so the
+    // first loop can be vectorized. Nodes are only touched when they change.
+    group->attachComponent< LambdaComponent >(
+        [ centers = std::move( centers ),
+          radii = std::move( radii ),
+          nodes = std::move( nodes ),
+          visible = std::vector< crimild::UInt8 >( count, 1 ),
+          current = std::vector< crimild::UInt8 >( count, 1 ),
+          perAsteroid = sources.size() ]( auto, auto & ) mutable {
+            // Asteroids whose projected radius is below half a pixel are hidden
+            const auto MIN_PIXEL_RADIUS = 0.5f;
+
+            auto camera = Camera::getMainCamera();
+            if ( camera == nullptr ) {
+                return;
+            }
+
+            // A sphere of radius r at distance d projects to a radius of about
+            // r / ( d * tan( fov / 2 ) ) in NDC, that is, that times height / 2
+            // in pixels. P[ 1 ][ 1 ] is 1 / tan( fov / 2 ) regardless of the
+            // projection conventions (its sign flips for a Y-down clip space).
+            const auto p = camera->getProjectionMatrix() * Vector4 { 0, 1, 0, 0 };
+            const auto height = std::max( 1, Simulation::getInstance()->getSettings()->get< crimild::Int32 >( "video.height", 768 ) );
+            const auto minRatio = 2.0f * MIN_PIXEL_RADIUS / ( std::abs( p.y ) * crimild::Real32( height ) );
+
+            const auto eye = location( camera->getWorld() );
+            const auto k = minRatio * minRatio;
+            const auto n = radii.size();
+
+            for ( crimild::Size i = 0; i < n; ++i ) {
+                const auto dx = centers[ 3 * i + 0 ] - eye.x;
+                const auto dy = centers[ 3 * i + 1 ] - eye.y;
+                const auto dz = centers[ 3 * i + 2 ] - eye.z;
+                visible[ i ] = radii[ i ] * radii[ i ] >= k * ( dx * dx + dy * dy + dz * dz );
+            }
+
+            for ( crimild::Size i = 0; i < n; ++i ) {
+                if ( visible[ i ] != current[ i ] ) {
+                    current[ i ] = visible[ i ];
+                    for ( crimild::Size j = 0; j < perAsteroid; ++j ) {
+                        nodes[ i * perAsteroid + j ]->setEnabled( visible[ i ] != 0 );
+                    }
+                }
+            }
+        } );
+
     // if ( options == OPTION_NO_INSTANCING ) {
     //     for ( const auto &t : ts ) {
     //         ShallowCopy copy;
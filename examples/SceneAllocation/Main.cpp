@@ -0,0 +1,413 @@
+/*
+ * Copyright (c) 2002 - present, H. Hernan Saez
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <Crimild.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace crimild;
+
+namespace crimild {
+
+    namespace examples {
+
+        /**
+           \brief A pool of fixed-size blocks
+
+           Blocks are carved out of large slabs, so objects of the same size class
+           end up next to each other in memory instead of being scattered all over
+           the heap. Released blocks are recycled through an intrusive free list.
+         */
+        class SlabPool {
+        public:
+            struct Stats {
+                Size slabs = 0;
+                Size allocations = 0;
+                Size deallocations = 0;
+                Size live = 0;
+                Size peak = 0;
+            };
+
+        public:
+            SlabPool( Size blockSize, Size blocksPerSlab = 4096 ) noexcept
+                : m_blockSize( blockSize ),
+                  m_blocksPerSlab( blocksPerSlab )
+            {
+            }
+
+            ~SlabPool( void ) noexcept
+            {
+                for ( auto slab : m_slabs ) {
+                    ::operator delete( slab );
+                }
+            }
+
+            void *allocate( void )
+            {
+                std::lock_guard< std::mutex > lock( m_mutex );
+
+                if ( m_freeList == nullptr ) {
+                    grow();
+                }
+
+                auto block = m_freeList;
+                m_freeList = m_freeList->next;
+
+                ++m_stats.allocations;
+                if ( ++m_stats.live > m_stats.peak ) {
+                    m_stats.peak = m_stats.live;
+                }
+
+                return block;
+            }
+
+            void deallocate( void *ptr ) noexcept
+            {
+                std::lock_guard< std::mutex > lock( m_mutex );
+
+                auto block = static_cast< FreeBlock * >( ptr );
+                block->next = m_freeList;
+                m_freeList = block;
+
+                ++m_stats.deallocations;
+                --m_stats.live;
+            }
+
+            inline Size getBlockSize( void ) const noexcept { return m_blockSize; }
+            inline const Stats &getStats( void ) const noexcept { return m_stats; }
+
+        private:
+            struct FreeBlock {
+                FreeBlock *next;
+            };
+
+            void grow( void )
+            {
+                auto slab = static_cast< char * >( ::operator new( m_blockSize * m_blocksPerSlab ) );
+                m_slabs.push_back( slab );
+                ++m_stats.slabs;
+
+                // Thread blocks in reverse order so they are handed out sequentially
+                for ( auto i = m_blocksPerSlab; i > 0; --i ) {
+                    auto block = reinterpret_cast< FreeBlock * >( slab + ( i - 1 ) * m_blockSize );
+                    block->next = m_freeList;
+                    m_freeList = block;
+                }
+            }
+
+        private:
+            Size m_blockSize;
+            Size m_blocksPerSlab;
+            FreeBlock *m_freeList = nullptr;
+            std::vector< char * > m_slabs;
+            Stats m_stats;
+            std::mutex m_mutex;
+        };
+
+        /**
+           \brief Size-classed slab pools
+
+           Requests are rounded up to a multiple of MIN_BLOCK_SIZE. Anything bigger
+           than MAX_BLOCK_SIZE is forwarded to the global allocator, and counted
+           separately so it doesn't go unnoticed.
+
+           Blocks are only guaranteed to be aligned to MIN_BLOCK_SIZE bytes, since
+           slabs come from the global allocator and blocks are a multiple of it.
+         */
+        class SlabPools {
+        public:
+            static constexpr Size MIN_BLOCK_SIZE = 16;
+            static constexpr Size MAX_BLOCK_SIZE = 1024;
+            static constexpr Size SIZE_CLASS_COUNT = MAX_BLOCK_SIZE / MIN_BLOCK_SIZE;
+
+            struct OversizeStats {
+                Size allocations = 0;
+                Size deallocations = 0;
+                Size largest = 0;
+            };
+
+        public:
+            static SlabPools &getInstance( void ) noexcept
+            {
+                static SlabPools instance;
+                return instance;
+            }
+
+            void *allocate( Size size )
+            {
+                if ( size > MAX_BLOCK_SIZE ) {
+                    {
+                        std::lock_guard< std::mutex > lock( m_oversizeMutex );
+                        ++m_oversize.allocations;
+                        m_oversize.largest = std::max( m_oversize.largest, size );
+                    }
+                    return ::operator new( size );
+                }
+                return getPool( size ).allocate();
+            }
+
+            void deallocate( void *ptr, Size size ) noexcept
+            {
+                if ( size > MAX_BLOCK_SIZE ) {
+                    {
+                        std::lock_guard< std::mutex > lock( m_oversizeMutex );
+                        ++m_oversize.deallocations;
+                    }
+                    ::operator delete( ptr );
+                    return;
+                }
+                getPool( size ).deallocate( ptr );
+            }
+
+            void printStats( std::ostream &out ) const noexcept
+            {
+                for ( const auto &pool : m_pools ) {
+                    const auto &stats = pool->getStats();
+                    if ( stats.allocations == 0 ) {
+                        continue;
+                    }
+                    out << "  " << pool->getBlockSize() << " bytes: "
+                        << stats.allocations << " allocs, "
+                        << stats.deallocations << " frees, "
+                        << stats.live << " live, "
+                        << stats.peak << " peak, "
+                        << stats.slabs << " slabs"
+                        << std::endl;
+                }
+
+                const auto oversize = getOversizeStats();
+                if ( oversize.allocations > 0 ) {
+                    out << "  over " << MAX_BLOCK_SIZE << " bytes (global allocator): "
+                        << oversize.allocations << " allocs, "
+                        << oversize.deallocations << " frees, "
+                        << oversize.largest << " bytes largest"
+                        << std::endl;
+                }
+            }
+
+            OversizeStats getOversizeStats( void ) const noexcept
+            {
+                std::lock_guard< std::mutex > lock( m_oversizeMutex );
+                return m_oversize;
+            }
+
+        private:
+            SlabPools( void ) noexcept
+            {
+                for ( Size i = 0; i < SIZE_CLASS_COUNT; ++i ) {
+                    m_pools.push_back( std::make_unique< SlabPool >( ( i + 1 ) * MIN_BLOCK_SIZE ) );
+                }
+            }
+
+            SlabPool &getPool( Size size ) noexcept
+            {
+                return *m_pools[ ( size + MIN_BLOCK_SIZE - 1 ) / MIN_BLOCK_SIZE - 1 ];
+            }
+
+        private:
+            std::vector< std::unique_ptr< SlabPool > > m_pools;
+            OversizeStats m_oversize;
+            mutable std::mutex m_oversizeMutex;
+        };
+
+        /**
+           \brief STL allocator backed by SlabPools
+
+           When used with std::allocate_shared, the allocator is rebound to the
+           internal control block type, which means the reference counters are
+           stored in the same block as the object itself.
+         */
+        template< typename T >
+        class SlabAllocator {
+        public:
+            using value_type = T;
+
+            SlabAllocator( void ) noexcept = default;
+
+            template< typename U >
+            SlabAllocator( const SlabAllocator< U > & ) noexcept { }
+
+            T *allocate( std::size_t n )
+            {
+                static_assert(
+                    alignof( T ) <= SlabPools::MIN_BLOCK_SIZE && alignof( T ) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__,
+                    "Slab blocks are not aligned enough for this type" );
+                return static_cast< T * >( SlabPools::getInstance().allocate( n * sizeof( T ) ) );
+            }
+
+            void deallocate( T *ptr, std::size_t n ) noexcept
+            {
+                SlabPools::getInstance().deallocate( ptr, n * sizeof( T ) );
+            }
+        };
+
+        template< typename T, typename U >
+        bool operator==( const SlabAllocator< T > &, const SlabAllocator< U > & ) noexcept { return true; }
+
+        template< typename T, typename U >
+        bool operator!=( const SlabAllocator< T > &, const SlabAllocator< U > & ) noexcept { return false; }
+
+        /**
+           \brief Same as crimild::alloc, but using slab pools
+         */
+        template< typename T, typename... Args >
+        SharedPointer< T > slab_alloc( Args &&...args )
+        {
+            return std::allocate_shared< T >( SlabAllocator< T >(), std::forward< Args >( args )... );
+        }
+
+    }
+
+}
+
+using namespace crimild::examples;
+
+struct Allocator {
+    template< typename T, typename... Args >
+    static SharedPointer< T > alloc( Args &&...args ) { return crimild::alloc< T >( std::forward< Args >( args )... ); }
+};
+
+struct PooledAllocator {
+    template< typename T, typename... Args >
+    static SharedPointer< T > alloc( Args &&...args ) { return slab_alloc< T >( std::forward< Args >( args )... ); }
+};
+
+struct Timings {
+    double build;
+    double update;
+    double teardown;
+};
+
+template< typename AllocatorType >
+Timings run( Size nodeCount )
+{
+    using Clock = std::chrono::high_resolution_clock;
+    using Milliseconds = std::chrono::duration< double, std::milli >;
+
+    auto primitive = crimild::alloc< Primitive >( Primitive::Type::BOX );
+    auto material = crimild::alloc< materials::PrincipledBSDF >();
+
+    auto t0 = Clock::now();
+
+    auto scene = AllocatorType::template alloc< Group >();
+    for ( Size i = 0; i < nodeCount; ++i ) {
+        auto geometry = AllocatorType::template alloc< Geometry >();
+        geometry->attachPrimitive( primitive );
+        geometry->setLocal( translation( Real( i % 100 ), Real( ( i / 100 ) % 100 ), Real( i / 10000 ) ) );
+        geometry->attachComponent( AllocatorType::template alloc< MaterialComponent >( material ) );
+        scene->attachNode( geometry );
+    }
+
+    auto t1 = Clock::now();
+
+    scene->perform( UpdateWorldState() );
+
+    auto t2 = Clock::now();
+
+    scene = nullptr;
+
+    auto t3 = Clock::now();
+
+    return Timings {
+        Milliseconds( t1 - t0 ).count(),
+        Milliseconds( t2 - t1 ).count(),
+        Milliseconds( t3 - t2 ).count(),
+    };
+}
+
+void print( const std::string &name, const std::vector< Timings > &rounds )
+{
+    // Best of all rounds, which is the least affected by noise
+    auto best = rounds.front();
+    for ( const auto &t : rounds ) {
+        best.build = std::min( best.build, t.build );
+        best.update = std::min( best.update, t.update );
+        best.teardown = std::min( best.teardown, t.teardown );
+    }
+
+    std::cout << name << ": "
+              << "build " << best.build << "ms, "
+              << "update " << best.update << "ms, "
+              << "teardown " << best.teardown << "ms"
+              << std::endl;
+}
+
+int main( int argc, char **argv )
+{
+    Size nodeCount = 100000;
+    Size roundCount = 5;
+    try {
+        if ( argc > 1 ) {
+            nodeCount = std::stoul( argv[ 1 ] );
+        }
+        if ( argc > 2 ) {
+            roundCount = std::max( Size( 1 ), Size( std::stoul( argv[ 2 ] ) ) );
+        }
+    } catch ( const std::exception & ) {
+        std::cout << "Usage: " << argv[ 0 ] << " [nodes] [rounds]" << std::endl;
+        return 1;
+    }
+
+    std::cout << "Building scenes with " << nodeCount << " nodes, best of " << roundCount << " rounds" << std::endl;
+
+    // Warm up both paths first, so neither one pays for a cold heap or for
+    // the slabs being allocated for the first time. Then alternate which one
+    // goes first in each round so the order doesn't favor any of them.
+    run< Allocator >( nodeCount );
+    run< PooledAllocator >( nodeCount );
+
+    std::vector< Timings > defaultRounds;
+    std::vector< Timings > pooledRounds;
+    for ( Size i = 0; i < roundCount; ++i ) {
+        if ( i % 2 == 0 ) {
+            defaultRounds.push_back( run< Allocator >( nodeCount ) );
+            pooledRounds.push_back( run< PooledAllocator >( nodeCount ) );
+        } else {
+            pooledRounds.push_back( run< PooledAllocator >( nodeCount ) );
+            defaultRounds.push_back( run< Allocator >( nodeCount ) );
+        }
+    }
+
+    print( "crimild::alloc", defaultRounds );
+    print( "slab_alloc", pooledRounds );
+
+    std::cout << "Slab pools:" << std::endl;
+    SlabPools::getInstance().printStats( std::cout );
+
+    if ( SlabPools::getInstance().getOversizeStats().allocations > 0 ) {
+        std::cout << "Warning: some allocations were too large for the slab pools, so slab_alloc "
+                  << "timings include the global allocator for them" << std::endl;
+    }
+
+    return 0;
+}
@@ -123,6 +123,11 @@ public:
                         auto material = crimild::alloc< LitMaterial >();
                         material->setMetallic( 0.0f );
                         material->setRoughness( 1.0f );
+                        // The room encloses both lights and objects and, being convex,
+                        // it can't block light from reaching anything inside of it.
+                        // Excluding it from shadow casters saves rendering it into each
+                        // cubemap face for every light, every frame.
+                        material->setCastShadows( false );
                         return material;
                     }();
 
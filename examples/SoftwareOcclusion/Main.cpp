@@ -0,0 +1,399 @@
+/*
+ * Copyright (c) 2002 - present, H. Hernan Saez
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <Crimild.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+using namespace crimild;
+
+namespace crimild {
+
+    namespace examples {
+
+        struct ClipVertex {
+            Real32 x, y, z, w;
+        };
+
+        /**
+           \brief Transforms a point to clip space
+
+           Only relative depths matter for occlusion, so this works the same
+           whether the projection maps depth to [0, 1] or [-1, 1] and whether it
+           flips Y or not, as long as occluders and boxes use the same matrix.
+         */
+        inline ClipVertex project( const Matrix4 &M, Real32 x, Real32 y, Real32 z ) noexcept
+        {
+            const auto v = M * Vector4 { x, y, z, 1 };
+            return ClipVertex { Real32( v.x ), Real32( v.y ), Real32( v.z ), Real32( v.w ) };
+        }
+
+        /**
+           \brief Low resolution depth buffer for occluders, rasterized on the CPU
+
+           Occluder triangles are binned into screen tiles first. Tiles never share
+           pixels, so each one is rasterized by an independent job. Depth values are
+           in [0, 1], where 1 is the far plane.
+
+           Triangles crossing the near plane are skipped instead of clipped. That
+           only means less occlusion, never wrong culling.
+         */
+        class SoftwareDepthBuffer {
+        public:
+            SoftwareDepthBuffer( Size width, Size height, Size tileSize = 32 ) noexcept
+                : m_width( width ),
+                  m_height( height ),
+                  m_tileSize( tileSize ),
+                  m_tilesX( ( width + tileSize - 1 ) / tileSize ),
+                  m_tilesY( ( height + tileSize - 1 ) / tileSize ),
+                  m_depth( width * height, 1.0f ),
+                  m_bins( m_tilesX * m_tilesY )
+            {
+            }
+
+            inline Size getWidth( void ) const noexcept { return m_width; }
+            inline Size getHeight( void ) const noexcept { return m_height; }
+            inline const Real32 *getData( void ) const noexcept { return m_depth.data(); }
+
+            void clear( void ) noexcept
+            {
+                std::fill( m_depth.begin(), m_depth.end(), 1.0f );
+                m_triangles.clear();
+                for ( auto &bin : m_bins ) {
+                    bin.clear();
+                }
+            }
+
+            void addTriangle( const ClipVertex &v0, const ClipVertex &v1, const ClipVertex &v2 ) noexcept
+            {
+                if ( v0.w <= 0.0f || v1.w <= 0.0f || v2.w <= 0.0f ) {
+                    return;
+                }
+
+                ScreenTriangle t;
+                toScreen( v0, t.x[ 0 ], t.y[ 0 ], t.z[ 0 ] );
+                toScreen( v1, t.x[ 1 ], t.y[ 1 ], t.z[ 1 ] );
+                toScreen( v2, t.x[ 2 ], t.y[ 2 ], t.z[ 2 ] );
+
+                // Use counter-clockwise winding, discarding degenerate triangles
+                const auto area = ( t.x[ 1 ] - t.x[ 0 ] ) * ( t.y[ 2 ] - t.y[ 0 ] ) - ( t.x[ 2 ] - t.x[ 0 ] ) * ( t.y[ 1 ] - t.y[ 0 ] );
+                if ( std::abs( area ) < 1e-6f ) {
+                    return;
+                }
+                if ( area < 0.0f ) {
+                    std::swap( t.x[ 1 ], t.x[ 2 ] );
+                    std::swap( t.y[ 1 ], t.y[ 2 ] );
+                    std::swap( t.z[ 1 ], t.z[ 2 ] );
+                }
+
+                const auto minX = std::max( 0, Int32( std::floor( std::min( { t.x[ 0 ], t.x[ 1 ], t.x[ 2 ] } ) ) ) );
+                const auto maxX = std::min( Int32( m_width ) - 1, Int32( std::ceil( std::max( { t.x[ 0 ], t.x[ 1 ], t.x[ 2 ] } ) ) ) );
+                const auto minY = std::max( 0, Int32( std::floor( std::min( { t.y[ 0 ], t.y[ 1 ], t.y[ 2 ] } ) ) ) );
+                const auto maxY = std::min( Int32( m_height ) - 1, Int32( std::ceil( std::max( { t.y[ 0 ], t.y[ 1 ], t.y[ 2 ] } ) ) ) );
+                if ( minX > maxX || minY > maxY ) {
+                    return;
+                }
+
+                const auto index = m_triangles.size();
+                m_triangles.push_back( t );
+
+                for ( auto ty = minY / Int32( m_tileSize ); ty <= maxY / Int32( m_tileSize ); ++ty ) {
+                    for ( auto tx = minX / Int32( m_tileSize ); tx <= maxX / Int32( m_tileSize ); ++tx ) {
+                        m_bins[ ty * m_tilesX + tx ].push_back( index );
+                    }
+                }
+            }
+
+            void rasterize( void ) noexcept
+            {
+                auto parent = crimild::concurrency::async();
+                for ( Size tile = 0; tile < m_bins.size(); ++tile ) {
+                    if ( m_bins[ tile ].empty() ) {
+                        continue;
+                    }
+                    crimild::concurrency::async( parent, [ this, tile ]() {
+                        rasterizeTile( tile );
+                    } );
+                }
+                crimild::concurrency::wait( parent );
+            }
+
+        private:
+            struct ScreenTriangle {
+                Real32 x[ 3 ];
+                Real32 y[ 3 ];
+                Real32 z[ 3 ];
+            };
+
+            void toScreen( const ClipVertex &v, Real32 &x, Real32 &y, Real32 &z ) const noexcept
+            {
+                const auto invW = 1.0f / v.w;
+                x = ( 0.5f * v.x * invW + 0.5f ) * m_width;
+                y = ( 0.5f - 0.5f * v.y * invW ) * m_height;
+                z = v.z * invW;
+            }
+
+            void rasterizeTile( Size tile ) noexcept
+            {
+                const auto x0 = Int32( ( tile % m_tilesX ) * m_tileSize );
+                const auto y0 = Int32( ( tile / m_tilesX ) * m_tileSize );
+                const auto x1 = std::min( x0 + Int32( m_tileSize ), Int32( m_width ) );
+                const auto y1 = std::min( y0 + Int32( m_tileSize ), Int32( m_height ) );
+
+                for ( auto index : m_bins[ tile ] ) {
+                    const auto &t = m_triangles[ index ];
+
+                    // Edge functions are linear in x, so each row is evaluated
+                    // incrementally. Inner loops have no branches other than the
+                    // coverage test and can be vectorized by the compiler.
+                    const Real32 a0 = t.y[ 1 ] - t.y[ 2 ], b0 = t.x[ 2 ] - t.x[ 1 ];
+                    const Real32 a1 = t.y[ 2 ] - t.y[ 0 ], b1 = t.x[ 0 ] - t.x[ 2 ];
+                    const Real32 a2 = t.y[ 0 ] - t.y[ 1 ], b2 = t.x[ 1 ] - t.x[ 0 ];
+                    const Real32 area = a0 * ( t.x[ 0 ] - t.x[ 1 ] ) + b0 * ( t.y[ 0 ] - t.y[ 1 ] );
+                    const Real32 invArea = 1.0f / area;
+
+                    for ( auto y = y0; y < y1; ++y ) {
+                        const auto py = Real32( y ) + 0.5f;
+                        auto row = &m_depth[ y * m_width ];
+                        for ( auto x = x0; x < x1; ++x ) {
+                            const auto px = Real32( x ) + 0.5f;
+                            const auto w0 = a0 * ( px - t.x[ 1 ] ) + b0 * ( py - t.y[ 1 ] );
+                            const auto w1 = a1 * ( px - t.x[ 2 ] ) + b1 * ( py - t.y[ 2 ] );
+                            const auto w2 = a2 * ( px - t.x[ 0 ] ) + b2 * ( py - t.y[ 0 ] );
+                            if ( w0 >= 0.0f && w1 >= 0.0f && w2 >= 0.0f ) {
+                                const auto z = ( w0 * t.z[ 0 ] + w1 * t.z[ 1 ] + w2 * t.z[ 2 ] ) * invArea;
+                                row[ x ] = std::min( row[ x ], z );
+                            }
+                        }
+                    }
+                }
+            }
+
+        private:
+            Size m_width;
+            Size m_height;
+            Size m_tileSize;
+            Size m_tilesX;
+            Size m_tilesY;
+            std::vector< Real32 > m_depth;
+            std::vector< ScreenTriangle > m_triangles;
+            std::vector< std::vector< Size > > m_bins;
+        };
+
+        /**
+           \brief Hierarchical-Z pyramid built from a software depth buffer
+
+           Each texel in level N+1 stores the farthest depth of the 2x2 texels
+           below it, so a single lookup conservatively bounds the depth of a whole
+           screen region.
+         */
+        class HiZPyramid {
+        public:
+            void build( const SoftwareDepthBuffer &depth ) noexcept
+            {
+                m_levels.clear();
+                m_levels.push_back( Level { depth.getWidth(), depth.getHeight(), std::vector< Real32 >( depth.getData(), depth.getData() + depth.getWidth() * depth.getHeight() ) } );
+
+                while ( m_levels.back().width > 1 || m_levels.back().height > 1 ) {
+                    const auto &src = m_levels.back();
+                    Level dst;
+                    dst.width = std::max< Size >( 1, ( src.width + 1 ) / 2 );
+                    dst.height = std::max< Size >( 1, ( src.height + 1 ) / 2 );
+                    dst.depth.resize( dst.width * dst.height );
+                    for ( Size y = 0; y < dst.height; ++y ) {
+                        for ( Size x = 0; x < dst.width; ++x ) {
+                            const auto sx0 = std::min( 2 * x, src.width - 1 );
+                            const auto sx1 = std::min( 2 * x + 1, src.width - 1 );
+                            const auto sy0 = std::min( 2 * y, src.height - 1 );
+                            const auto sy1 = std::min( 2 * y + 1, src.height - 1 );
+                            dst.depth[ y * dst.width + x ] = std::max(
+                                std::max( src.depth[ sy0 * src.width + sx0 ], src.depth[ sy0 * src.width + sx1 ] ),
+                                std::max( src.depth[ sy1 * src.width + sx0 ], src.depth[ sy1 * src.width + sx1 ] ) );
+                        }
+                    }
+                    m_levels.push_back( std::move( dst ) );
+                }
+            }
+
+            /**
+               \brief Test a world-space box against the pyramid
+
+               \returns false only if the box is guaranteed to be hidden behind
+               occluders. Boxes crossing the near plane are always visible.
+             */
+            Bool isVisible( const Matrix4 &viewProj, const Real32 min[ 3 ], const Real32 max[ 3 ] ) const noexcept
+            {
+                const auto &base = m_levels.front();
+
+                Real32 x0 = std::numeric_limits< Real32 >::max(), y0 = x0, z0 = x0;
+                Real32 x1 = -x0, y1 = -x0;
+                for ( auto i = 0; i < 8; ++i ) {
+                    auto v = project(
+                        viewProj,
+                        ( i & 1 ) ? max[ 0 ] : min[ 0 ],
+                        ( i & 2 ) ? max[ 1 ] : min[ 1 ],
+                        ( i & 4 ) ? max[ 2 ] : min[ 2 ] );
+                    if ( v.w <= 0.0f ) {
+                        return true;
+                    }
+                    const auto invW = 1.0f / v.w;
+                    const auto sx = ( 0.5f * v.x * invW + 0.5f ) * base.width;
+                    const auto sy = ( 0.5f - 0.5f * v.y * invW ) * base.height;
+                    x0 = std::min( x0, sx );
+                    x1 = std::max( x1, sx );
+                    y0 = std::min( y0, sy );
+                    y1 = std::max( y1, sy );
+                    z0 = std::min( z0, v.z * invW );
+                }
+
+                // Outside the screen. That's frustum culling's job, not ours
+                if ( x1 < 0 || y1 < 0 || x0 >= base.width || y0 >= base.height ) {
+                    return true;
+                }
+
+                x0 = std::max( x0, 0.0f );
+                y0 = std::max( y0, 0.0f );
+                x1 = std::min( x1, Real32( base.width - 1 ) );
+                y1 = std::min( y1, Real32( base.height - 1 ) );
+
+                // Pick the level in which the rect covers at most 2x2 texels
+                const auto extent = std::max( x1 - x0, y1 - y0 );
+                auto level = std::min< Size >( m_levels.size() - 1, Size( std::ceil( std::log2( std::max( extent, 1.0f ) ) ) ) );
+                const auto &L = m_levels[ level ];
+                const auto scale = 1.0f / Real32( 1 << level );
+
+                const auto lx0 = std::min( Size( x0 * scale ), L.width - 1 );
+                const auto lx1 = std::min( Size( x1 * scale ), L.width - 1 );
+                const auto ly0 = std::min( Size( y0 * scale ), L.height - 1 );
+                const auto ly1 = std::min( Size( y1 * scale ), L.height - 1 );
+                for ( auto y = ly0; y <= ly1; ++y ) {
+                    for ( auto x = lx0; x <= lx1; ++x ) {
+                        if ( z0 <= L.depth[ y * L.width + x ] ) {
+                            return true;
+                        }
+                    }
+                }
+
+                return false;
+            }
+
+        private:
+            struct Level {
+                Size width;
+                Size height;
+                std::vector< Real32 > depth;
+            };
+
+            std::vector< Level > m_levels;
+        };
+
+    }
+
+}
+
+using namespace crimild::examples;
+
+int main( int argc, char **argv )
+{
+    crimild::concurrency::JobScheduler jobScheduler;
+    jobScheduler.configure();
+    jobScheduler.start();
+
+    // Camera at the origin, looking down -Z, so its view matrix is the identity
+    auto camera = crimild::alloc< Camera >( 90.0f, 4.0f / 3.0f, 0.1f, 100.0f );
+    const auto viewProj = camera->getProjectionMatrix();
+
+    // A wall at z = -5 acts as the only occluder
+    auto addQuad = []( SoftwareDepthBuffer &depth, const Matrix4 &M, Real32 x0, Real32 y0, Real32 x1, Real32 y1, Real32 z ) {
+        auto a = project( M, x0, y0, z );
+        auto b = project( M, x1, y0, z );
+        auto c = project( M, x1, y1, z );
+        auto d = project( M, x0, y1, z );
+        depth.addTriangle( a, b, c );
+        depth.addTriangle( a, c, d );
+    };
+
+    struct Box {
+        Real32 min[ 3 ];
+        Real32 max[ 3 ];
+        Bool expectedVisible;
+    };
+
+    std::vector< Box > boxes = {
+        { { -1.0f, -1.0f, -21.0f }, { 1.0f, 1.0f, -19.0f }, false },  // behind the wall
+        { { -0.5f, -0.5f, -3.5f }, { 0.5f, 0.5f, -2.5f }, true },     // in front of the wall
+        { { 20.0f, -1.0f, -21.0f }, { 22.0f, 1.0f, -19.0f }, true },  // next to the wall
+        { { -1.0f, 3.5f, -8.0f }, { 1.0f, 5.0f, -6.0f }, true },      // peeking over the wall
+        { { -1.0f, -1.0f, -6.0f }, { 1.0f, 1.0f, -4.0f }, true },     // intersecting the wall
+        { { -2.0f, -2.0f, -60.0f }, { 2.0f, 2.0f, -50.0f }, false },  // far behind the wall
+    };
+
+    using Clock = std::chrono::high_resolution_clock;
+    using Microseconds = std::chrono::duration< double, std::micro >;
+
+    SoftwareDepthBuffer depth( 256, 192 );
+    HiZPyramid hiZ;
+
+    auto t0 = Clock::now();
+    addQuad( depth, viewProj, -4.0f, -3.0f, 4.0f, 3.0f, -5.0f );
+    depth.rasterize();
+    auto t1 = Clock::now();
+    hiZ.build( depth );
+    auto t2 = Clock::now();
+
+    Size culled = 0;
+    Size failures = 0;
+    for ( const auto &box : boxes ) {
+        const auto visible = hiZ.isVisible( viewProj, box.min, box.max );
+        if ( !visible ) {
+            ++culled;
+        }
+        if ( visible != box.expectedVisible ) {
+            ++failures;
+        }
+    }
+    auto t3 = Clock::now();
+
+    jobScheduler.stop();
+
+    std::cout << "Rasterize: " << Microseconds( t1 - t0 ).count() << "us, "
+              << "HiZ: " << Microseconds( t2 - t1 ).count() << "us, "
+              << "Tests: " << Microseconds( t3 - t2 ).count() << "us" << std::endl;
+    std::cout << "Culled " << culled << "/" << boxes.size() << " boxes" << std::endl;
+
+    if ( failures > 0 ) {
+        std::cout << failures << " boxes with unexpected visibility" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
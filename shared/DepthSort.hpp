@@ -0,0 +1,230 @@
+/*
+ * Copyright (c) 2002 - present, H. Hernan Saez
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef CRIMILD_EXAMPLES_SHARED_DEPTH_SORT_
+#define CRIMILD_EXAMPLES_SHARED_DEPTH_SORT_
+
+#include <Crimild.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace crimild {
+
+    namespace examples {
+
+        /**
+           \brief Sorts (key, index) pairs by key
+
+           Pairs are expected to be in last frame's order, which is usually
+           almost sorted. An insertion sort is tried first and it gives up once
+           it has moved more than a fixed number of pairs per element, so its
+           cost never goes above a couple of radix passes. Then, an LSD radix
+           sort finishes the job starting from whatever order was left.
+
+           Radix histograms and scatters are computed in parallel over
+           fixed-size chunks for large inputs.
+         */
+        class DepthSort {
+        public:
+            struct Pair {
+                UInt32 key;
+                UInt32 index;
+            };
+
+            enum class Result {
+                UNCHANGED,
+                INSERTION,
+                RADIX,
+            };
+
+        private:
+            static constexpr Size CHUNK_SIZE = 16384;
+            static constexpr Size RADIX = 256;
+
+            /**
+               \brief How many moves per pair the insertion sort can make
+
+               A radix sort reads and writes each pair twice per pass, and up
+               to four passes are needed. Giving up after four moves per pair
+               keeps the worst case (insertion failing and radix running
+               anyway) below twice the cost of a radix sort.
+             */
+            static constexpr Size MAX_INSERTION_MOVES_PER_PAIR = 4;
+
+        public:
+            /**
+               \brief Maps a distance to a key so that farther particles come first
+
+               For non-negative floats, the bit pattern grows with the value.
+               Inverting it gives the descending (back-to-front) order.
+             */
+            static UInt32 toKey( Real32 distance ) noexcept
+            {
+                UInt32 bits;
+                std::memcpy( &bits, &distance, sizeof( bits ) );
+                return ~bits;
+            }
+
+        public:
+            inline std::vector< Pair > &getPairs( void ) noexcept { return m_pairs; }
+            inline const std::vector< Pair > &getPairs( void ) const noexcept { return m_pairs; }
+
+            Result sort( void ) noexcept
+            {
+                if ( m_pairs.size() < 2 ) {
+                    return Result::UNCHANGED;
+                }
+
+                Size moves = 0;
+                if ( insertionSort( MAX_INSERTION_MOVES_PER_PAIR * m_pairs.size(), moves ) ) {
+                    return moves == 0 ? Result::UNCHANGED : Result::INSERTION;
+                }
+
+                radixSort();
+                return Result::RADIX;
+            }
+
+        private:
+            /**
+               \brief Sorts pairs, unless that takes more than maxMoves moves
+
+               Returns false if the budget runs out. Pairs are still a valid
+               permutation at that point (only partially sorted).
+             */
+            Bool insertionSort( Size maxMoves, Size &moves ) noexcept
+            {
+                for ( Size i = 1; i < m_pairs.size(); ++i ) {
+                    const auto p = m_pairs[ i ];
+                    auto j = i;
+                    while ( j > 0 && m_pairs[ j - 1 ].key > p.key ) {
+                        m_pairs[ j ] = m_pairs[ j - 1 ];
+                        --j;
+                    }
+                    m_pairs[ j ] = p;
+
+                    moves += i - j;
+                    if ( moves > maxMoves ) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            void radixSort( void ) noexcept
+            {
+                const auto count = m_pairs.size();
+                const auto chunks = ( count + CHUNK_SIZE - 1 ) / CHUNK_SIZE;
+                m_scratch.resize( count );
+                m_histograms.resize( chunks * RADIX );
+
+                auto src = m_pairs.data();
+                auto dst = m_scratch.data();
+
+                for ( UInt32 shift = 0; shift < 32; shift += 8 ) {
+                    std::fill( m_histograms.begin(), m_histograms.end(), Size( 0 ) );
+
+                    forEachChunk(
+                        chunks,
+                        [ this, src, count, shift ]( Size chunk ) {
+                            auto histogram = &m_histograms[ chunk * RADIX ];
+                            const auto end = std::min( count, ( chunk + 1 ) * CHUNK_SIZE );
+                            for ( auto i = chunk * CHUNK_SIZE; i < end; ++i ) {
+                                ++histogram[ ( src[ i ].key >> shift ) & 0xFF ];
+                            }
+                        } );
+
+                    // Turn counts into offsets, ordered by digit first and then by
+                    // chunk so the scatter is stable. If all keys share this digit,
+                    // the pass would leave pairs as they are and can be skipped.
+                    Size offset = 0;
+                    Bool uniform = false;
+                    for ( Size digit = 0; digit < RADIX; ++digit ) {
+                        Size total = 0;
+                        for ( Size chunk = 0; chunk < chunks; ++chunk ) {
+                            auto &h = m_histograms[ chunk * RADIX + digit ];
+                            const auto n = h;
+                            h = offset + total;
+                            total += n;
+                        }
+                        if ( total == count ) {
+                            uniform = true;
+                            break;
+                        }
+                        offset += total;
+                    }
+
+                    if ( uniform ) {
+                        continue;
+                    }
+
+                    forEachChunk(
+                        chunks,
+                        [ this, src, dst, count, shift ]( Size chunk ) {
+                            auto offsets = &m_histograms[ chunk * RADIX ];
+                            const auto end = std::min( count, ( chunk + 1 ) * CHUNK_SIZE );
+                            for ( auto i = chunk * CHUNK_SIZE; i < end; ++i ) {
+                                dst[ offsets[ ( src[ i ].key >> shift ) & 0xFF ]++ ] = src[ i ];
+                            }
+                        } );
+
+                    std::swap( src, dst );
+                }
+
+                if ( src != m_pairs.data() ) {
+                    std::copy( src, src + count, m_pairs.data() );
+                }
+            }
+
+            template< typename Fn >
+            static void forEachChunk( Size chunks, Fn fn ) noexcept
+            {
+                if ( chunks == 1 ) {
+                    fn( 0 );
+                    return;
+                }
+
+                auto parent = crimild::concurrency::async();
+                for ( Size chunk = 0; chunk < chunks; ++chunk ) {
+                    crimild::concurrency::async( parent, [ fn, chunk ]() { fn( chunk ); } );
+                }
+                crimild::concurrency::wait( parent );
+            }
+
+        private:
+            std::vector< Pair > m_pairs;
+            std::vector< Pair > m_scratch;
+            std::vector< Size > m_histograms;
+        };
+
+    }
+
+}
+
+#endif